@@ -1,18 +1,73 @@
 // LocalOpts.cpp
 #include "llvm/Transforms/Utils/LocalOpts.h"
 
+// DEBUG_TYPE: nome per -debug-only e -stats, va definito prima di
+// InstructionWorklist (usa LLVM_DEBUG)
+#define DEBUG_TYPE "local-opts"
+#include "llvm/Transforms/Utils/InstructionWorklist.h"
+
 using namespace llvm;
 
+// Contatori per regola, visibili con -stats
+STATISTIC(NumAddIdentity, "ADD identity: x + 0 -> x");
+STATISTIC(NumSubIdentity, "SUB identity: x - 0 -> x");
+STATISTIC(NumMulIdentity, "MUL identity: x * 1 -> x");
+STATISTIC(NumSDivIdentity, "SDIV identity: x / 1 -> x");
+STATISTIC(NumUDivIdentity, "UDIV identity: x / 1 -> x");
+STATISTIC(NumMulShl, "MUL -> shl (potenza di 2)");
+STATISTIC(NumMulShiftAdd, "MUL -> catena shl/add/sub (non potenza di 2)");
+STATISTIC(NumMulKept, "MUL lasciate: catena non conveniente sul target");
+STATISTIC(NumSDivBiasShift, "SDIV -> ashr con bias (potenza di 2)");
+STATISTIC(NumSDivMagic, "SDIV -> magic multiply (costante qualsiasi)");
+STATISTIC(NumUDivShr, "UDIV -> lshr (potenza di 2)");
+STATISTIC(NumUDivMagic, "UDIV -> magic multiply (costante qualsiasi)");
+STATISTIC(NumURemAnd, "UREM -> and (potenza di 2)");
+STATISTIC(NumSRemPow2, "SREM -> sub/and con bias (potenza di 2)");
+STATISTIC(NumRemMagic, "SREM/UREM -> x - (x / C) * C");
+STATISTIC(NumDivKept, "DIV/REM lasciate: magic multiply non conveniente");
+STATISTIC(NumAddSubFold, "MultiInstr: (x + C) - C -> x");
+STATISTIC(NumSubSubFold, "MultiInstr: C - (C - x) -> x");
+STATISTIC(NumSubAddFold, "MultiInstr: (x - C) + C -> x");
+STATISTIC(NumReassoc, "Catene add/sub/mul con costanti riassociate");
+STATISTIC(NumSignedToUnsigned, "SDIV/SREM -> UDIV/UREM (dividendo non negativo)");
+STATISTIC(NumDivRemRange, "UDIV/UREM con dividendo < C -> 0 / x");
+STATISTIC(NumUDivPow2Val, "UDIV per potenza di 2 non costante -> lshr");
+STATISTIC(NumURemPow2Val, "UREM per potenza di 2 non costante -> and");
+STATISTIC(NumMaskRemoved, "AND ridondante rimossa (known bits / range)");
+STATISTIC(NumFAddIdentity, "FADD identity: x + -0.0 (o +0.0 con nsz) -> x");
+STATISTIC(NumFSubIdentity, "FSUB identity: x - +0.0 (o -0.0 con nsz) -> x");
+STATISTIC(NumFMulIdentity, "FMUL identity: x * 1.0 -> x");
+STATISTIC(NumFDivIdentity, "FDIV identity: x / 1.0 -> x");
+STATISTIC(NumFDivRecip, "FDIV -> fmul per reciproco esatto (2^k)");
+STATISTIC(NumFDivRecipArcp, "FDIV -> fmul per reciproco approssimato (arcp)");
+STATISTIC(NumFMulSR, "FMUL x*2.0 -> fadd, x*-1.0 -> fneg");
+STATISTIC(NumFPReassoc, "Catene fadd/fmul con costanti piegate (reassoc)");
+STATISTIC(NumCSE, "Istruzioni ridondanti riusate (value numbering locale)");
+STATISTIC(NumDeadErased, "Istruzioni morte cancellate (operandi e codice morto)");
+STATISTIC(NumIterationCapHit, "Blocchi fermati dal limite di riscritture");
+
+// Limite di riscritture per blocco: protegge da eventuali cicli tra regole
+static cl::opt<unsigned> LocalOptsMaxIterations(
+    "local-opts-max-iterations", cl::init(100000), cl::Hidden,
+    cl::desc("Numero massimo di riscritture per basic block in LocalOpts"));
+
 
 // Cicla su tutti i BB di F, per ogni BB chiama runOnBasicBlock.
 // Accumula i cambiamenti e lo ritorna se c'è stato
 llvm::PreservedAnalyses llvm::LocalOpts::run(Function &F,
                                              FunctionAnalysisManager &FAM) {
-  llvm::errs() << "\nRunning on functio: " << F.getName() << "\n";
+  LLVM_DEBUG(dbgs() << "\nRunning on function: " << F.getName() << "\n");
   bool functionChanged = false;
+  // costi del target per decidere se una catena shl/add conviene sulla mul,
+  // known bits e range LVI per scegliere la riduzione piu economica
+  LocalOptsAnalyses A{FAM.getResult<TargetIRAnalysis>(F),
+                      F.getParent()->getDataLayout(),
+                      &FAM.getResult<AssumptionAnalysis>(F),
+                      &FAM.getResult<DominatorTreeAnalysis>(F),
+                      &FAM.getResult<LazyValueAnalysis>(F)};
 
   for (auto &BB : F)
-    functionChanged |= runOnBasicBlock(BB);
+    functionChanged |= runOnBasicBlock(BB, A);
 
   return functionChanged ? llvm::PreservedAnalyses::none()
                          : llvm::PreservedAnalyses::all();
@@ -20,41 +75,415 @@ llvm::PreservedAnalyses llvm::LocalOpts::run(Function &F,
 
 
 
-// Cuore operativo:
-// scorre le istruzioni del BB
-// prova a ottimizzarle chiamando le Utility
-// raccoglie quelle modificate
-// cancella le modificate in sicurezza
-bool LocalOpts::runOnBasicBlock(llvm::BasicBlock &B) {
+// ---- Tabella delle regole ----
+// Ogni regola dichiara l'opcode della radice e la forma degli operandi che
+// le serve (costante a sinistra/destra, operatore binario interno, ...).
+// L'indice per opcode si costruisce una volta sola: un'istruzione viene
+// provata solo contro le regole del suo opcode la cui forma e compatibile.
+// Per aggiungere una regola basta una riga in LocalOptsRules.
+
+namespace {
+// Forma degli operandi di un'istruzione binaria (bit combinabili)
+enum OperandShape : unsigned {
+  SH_None = 0,
+  SH_ConstLHS = 1 << 0,  // operando 0 costante
+  SH_ConstRHS = 1 << 1,  // operando 1 costante
+  SH_AnyConst = 1 << 2,  // almeno un operando costante
+  SH_BinOpLHS = 1 << 3,  // operando 0 e un operatore binario
+  SH_BinOpRHS = 1 << 4,  // operando 1 e un operatore binario
+  SH_AnyBinOp = 1 << 5,  // almeno un operando e un operatore binario
+};
+
+struct LocalOptsRule {
+  unsigned Opcode; // opcode della radice
+  unsigned Shape;  // bit di OperandShape richiesti (tutti)
+  const char *Name;
+  bool (*Apply)(Instruction &I, const LocalOptsAnalyses &A);
+};
+
+bool identity(Instruction &I, const LocalOptsAnalyses &) {
+  return LocalOpts::AlgebraicIdentityOpt2(I);
+}
+bool strength(Instruction &I, const LocalOptsAnalyses &A) {
+  return LocalOpts::StrengthReductionOpt(I, A.TTI);
+}
+bool valueTracking(Instruction &I, const LocalOptsAnalyses &A) {
+  return LocalOpts::ValueTrackingSROpt(I, A);
+}
+bool multiInstr(Instruction &I, const LocalOptsAnalyses &) {
+  return LocalOpts::MultiInstructionOpt(I);
+}
+bool reassoc(Instruction &I, const LocalOptsAnalyses &) {
+  return LocalOpts::ReassociateOpt(I);
+}
+bool fpIdentity(Instruction &I, const LocalOptsAnalyses &) {
+  return LocalOpts::FPAlgebraicIdentityOpt(I);
+}
+bool fpStrength(Instruction &I, const LocalOptsAnalyses &) {
+  return LocalOpts::FPStrengthReductionOpt(I);
+}
+bool fpReassoc(Instruction &I, const LocalOptsAnalyses &) {
+  return LocalOpts::FPReassociateOpt(I);
+}
+
+// Le regole dello stesso opcode si provano nell'ordine della tabella.
+const LocalOptsRule LocalOptsRules[] = {
+    // opcode            forma operandi              nome           regola
+    {Instruction::Add,  SH_AnyConst,                "add-zero",    identity},
+    {Instruction::Add,  SH_AnyConst | SH_AnyBinOp,  "sub-add",     multiInstr},
+    {Instruction::Add,  SH_AnyBinOp,                "add-reassoc", reassoc},
+    {Instruction::Sub,  SH_ConstRHS,                "sub-zero",    identity},
+    {Instruction::Sub,  SH_ConstRHS | SH_BinOpLHS,  "add-sub",     multiInstr},
+    {Instruction::Sub,  SH_ConstLHS | SH_BinOpRHS,  "sub-sub",     multiInstr},
+    {Instruction::Sub,  SH_AnyBinOp,                "sub-reassoc", reassoc},
+    {Instruction::Mul,  SH_AnyConst,                "mul-one",     identity},
+    {Instruction::Mul,  SH_AnyBinOp,                "mul-reassoc", reassoc},
+    {Instruction::Mul,  SH_AnyConst,                "mul-sr",      strength},
+    {Instruction::SDiv, SH_ConstRHS,                "sdiv-one",    identity},
+    {Instruction::SDiv, SH_ConstRHS,                "sdiv-nonneg", valueTracking},
+    {Instruction::SDiv, SH_ConstRHS,                "sdiv-sr",     strength},
+    {Instruction::UDiv, SH_ConstRHS,                "udiv-one",    identity},
+    {Instruction::UDiv, SH_None,                    "udiv-known",  valueTracking},
+    {Instruction::UDiv, SH_ConstRHS,                "udiv-sr",     strength},
+    {Instruction::SRem, SH_ConstRHS,                "srem-nonneg", valueTracking},
+    {Instruction::SRem, SH_ConstRHS,                "srem-sr",     strength},
+    {Instruction::URem, SH_None,                    "urem-known",  valueTracking},
+    {Instruction::URem, SH_ConstRHS,                "urem-sr",     strength},
+    {Instruction::And,  SH_AnyConst,                "and-mask",    valueTracking},
+    {Instruction::FAdd, SH_AnyConst,                "fadd-zero",   fpIdentity},
+    {Instruction::FAdd, SH_AnyConst | SH_AnyBinOp,  "fadd-reassoc", fpReassoc},
+    {Instruction::FSub, SH_ConstRHS,                "fsub-zero",   fpIdentity},
+    {Instruction::FMul, SH_AnyConst,                "fmul-one",    fpIdentity},
+    {Instruction::FMul, SH_AnyConst | SH_AnyBinOp,  "fmul-reassoc", fpReassoc},
+    {Instruction::FMul, SH_AnyConst,                "fmul-sr",     fpStrength},
+    {Instruction::FDiv, SH_ConstRHS,                "fdiv-one",    fpIdentity},
+    {Instruction::FDiv, SH_ConstRHS,                "fdiv-sr",     fpStrength},
+};
+
+// Indice opcode -> regole, per i soli operatori binari
+class LocalOptsRuleIndex {
+public:
+  LocalOptsRuleIndex() {
+    for (const LocalOptsRule &R : LocalOptsRules) {
+      assert(Instruction::isBinaryOp(R.Opcode) && "solo operatori binari");
+      ByOpcode[R.Opcode - Instruction::BinaryOpsBegin].push_back(&R);
+    }
+  }
+
+  ArrayRef<const LocalOptsRule *> lookup(unsigned Opcode) const {
+    return ByOpcode[Opcode - Instruction::BinaryOpsBegin];
+  }
+
+private:
+  SmallVector<const LocalOptsRule *, 4>
+      ByOpcode[Instruction::BinaryOpsEnd - Instruction::BinaryOpsBegin];
+};
+
+const LocalOptsRuleIndex &getRuleIndex() {
+  static const LocalOptsRuleIndex Index;
+  return Index;
+}
+
+unsigned getOperandShape(Instruction &I) {
+  unsigned Shape = SH_None;
+  if (isa<Constant>(I.getOperand(0)))
+    Shape |= SH_ConstLHS | SH_AnyConst;
+  if (isa<Constant>(I.getOperand(1)))
+    Shape |= SH_ConstRHS | SH_AnyConst;
+  if (isa<BinaryOperator>(I.getOperand(0)))
+    Shape |= SH_BinOpLHS | SH_AnyBinOp;
+  if (isa<BinaryOperator>(I.getOperand(1)))
+    Shape |= SH_BinOpRHS | SH_AnyBinOp;
+  return Shape;
+}
+} // namespace
+
+// ---- Value numbering locale al blocco ----
+// Chiave di un'espressione pura: (opcode, tipo, predicato, operandi).
+// Per le operazioni commutative gli operandi sono in ordine canonico, per i
+// confronti si scambiano insieme al predicato, cosi a+b e b+a (o a<b e b>a)
+// hanno lo stesso numero. I flag (nsw, exact, fast-math) non fanno parte
+// della chiave: al riuso si tiene l'intersezione (andIRFlags).
+
+namespace {
+using ExprKey = std::tuple<unsigned, Type *, unsigned, Value *, Value *,
+                           Value *>;
+
+// Solo istruzioni senza effetti collaterali con al piu tre operandi
+std::optional<ExprKey> getExprKey(Instruction &I) {
+  if (!isa<BinaryOperator>(I) && !isa<CastInst>(I) && !isa<CmpInst>(I) &&
+      !isa<SelectInst>(I))
+    return std::nullopt;
+
+  Value *Ops[3] = {nullptr, nullptr, nullptr};
+  for (unsigned i = 0; i < I.getNumOperands(); ++i)
+    Ops[i] = I.getOperand(i);
+  unsigned Extra = 0;
+
+  if (auto *Cmp = dyn_cast<CmpInst>(&I)) {
+    CmpInst::Predicate Pred = Cmp->getPredicate();
+    if (std::less<Value *>()(Ops[1], Ops[0])) {
+      std::swap(Ops[0], Ops[1]);
+      Pred = CmpInst::getSwappedPredicate(Pred);
+    }
+    Extra = Pred;
+  } else if (I.isCommutative() && std::less<Value *>()(Ops[1], Ops[0])) {
+    std::swap(Ops[0], Ops[1]);
+  }
+  return ExprKey(I.getOpcode(), I.getType(), Extra, Ops[0], Ops[1], Ops[2]);
+}
+
+// Tabella hash-consed: chiave -> istruzione che la calcola nel blocco.
+// KeyOf ricorda con che chiave e registrata ogni istruzione, per poterla
+// togliere quando viene cancellata o quando i suoi operandi cambiano.
+class BlockValueTable {
+public:
+  Instruction *lookup(const ExprKey &K) const {
+    auto It = Avail.find(K);
+    return It == Avail.end() ? nullptr : It->second;
+  }
+
+  void insert(Instruction *I, const ExprKey &K) {
+    forget(I);
+    Avail[K] = I;
+    KeyOf[I] = K;
+  }
+
+  void forget(Instruction *I) {
+    auto It = KeyOf.find(I);
+    if (It == KeyOf.end())
+      return;
+    auto AIt = Avail.find(It->second);
+    if (AIt != Avail.end() && AIt->second == I)
+      Avail.erase(AIt);
+    KeyOf.erase(It);
+  }
+
+private:
+  DenseMap<ExprKey, Instruction *> Avail;
+  DenseMap<Instruction *, ExprKey> KeyOf;
+};
+} // namespace
+
+// Cuore operativo (worklist):
+// - il worklist parte con tutte le istruzioni del BB, in ordine
+// - ogni istruzione pura gia calcolata prima nel blocco (stessa chiave in
+//   BlockValueTable) viene sostituita da quella: le riscritture che emettono
+//   lo stesso shl/ashr piu volte condividono il lavoro
+// - ogni istruzione estratta viene provata contro le regole della tabella
+//   per il suo opcode, filtrate sulla forma degli operandi
+// - se una Utility riscrive I, rimettiamo in coda gli utenti di I e le
+//   istruzioni nuove create davanti a I (mul.sr.shl, sdiv.sr.*, ...)
+// - I non ha piu usi e viene cancellata subito, togliendola dal worklist,
+//   insieme agli operandi che restano morti (l'add interno di (x + C) - C):
+//   non serve un adce dopo local-opts
+// - un'istruzione gia morta quando viene estratta si cancella allo stesso modo
+// Si procede fino al punto fisso (worklist vuoto) o fino al limite di
+// riscritture per blocco (-local-opts-max-iterations).
+bool LocalOpts::runOnBasicBlock(llvm::BasicBlock &B,
+                                const LocalOptsAnalyses &A) {
   bool blockChanged = false;
-  std::set<Instruction *> toBeErased;
+  unsigned rewrites = 0;
+
+  InstructionWorklist Worklist;
+  Worklist.reserve(B.size());
+  // push al contrario: removeOne estrae dal fondo, quindi visitiamo in ordine
+  for (Instruction &I : llvm::reverse(B))
+    Worklist.push(&I);
+
+  // salva gli utenti di I nello stesso blocco: dopo la RAUW non sono
+  // piu raggiungibili da I
+  SmallVector<Instruction *, 8> Users;
+  SmallVector<const LocalOptsRule *, 4> Candidates;
+  const LocalOptsRuleIndex &Index = getRuleIndex();
+  BlockValueTable VN;
+
+  // cancella Dead (senza usi) e ricorsivamente gli operandi rimasti morti,
+  // tenendo allineati worklist e tabella dei valori
+  auto eraseDead = [&](Instruction *Dead) {
+    RecursivelyDeleteTriviallyDeadInstructions(
+        Dead, /*TLI=*/nullptr, /*MSSAU=*/nullptr, [&](Value *V) {
+          auto *D = cast<Instruction>(V);
+          if (D != Dead)
+            ++NumDeadErased;
+          VN.forget(D);
+          Worklist.remove(D);
+        });
+  };
 
-  for (auto &I : B) {
+  auto collectBlockUsers = [&](Instruction *I) {
+    Users.clear();
+    for (User *U : I->users())
+      if (auto *UI = dyn_cast<Instruction>(U))
+        if (UI->getParent() == &B)
+          Users.push_back(UI);
+  };
 
-    bool instructionChanged =
-        I.isBinaryOp() && (
-          AlgebraicIdentityOpt2(I) ||
-          StrengthReductionOpt(I)  ||
-          MultiInstructionOpt(I)
-        );
+  // remove() lascia nullptr nel worklist: non e la fine, si salta e si va avanti
+  while (!Worklist.isEmpty()) {
+    Instruction *I = Worklist.removeOne();
+    if (!I)
+      continue;
+    if (isInstructionTriviallyDead(I)) {
+      ++NumDeadErased;
+      eraseDead(I);
+      blockChanged = true;
+      continue;
+    }
 
+    // ---- value numbering ----
+    if (std::optional<ExprKey> K = getExprKey(*I)) {
+      Instruction *E = VN.lookup(*K);
+      // la voce puo essere vecchia se gli operandi di E sono cambiati
+      if (E && E != I && getExprKey(*E) == K) {
+        if (E->comesBefore(I)) {
+          // E calcola gia lo stesso valore: I e ridondante
+          collectBlockUsers(I);
+          E->andIRFlags(I);
+          I->replaceAllUsesWith(E);
+          for (Instruction *UI : Users)
+            Worklist.push(UI);
+          eraseDead(I);
+          ++NumCSE;
+          blockChanged = true;
+          continue;
+        }
+        // I viene prima: diventa lei il rappresentante, E si rivede dopo
+        Worklist.push(E);
+      }
+      VN.insert(I, *K);
+    }
 
-    if (instructionChanged)
-      toBeErased.insert(&I);
+    if (!I->isBinaryOp())
+      continue;
+
+    // solo le regole che possono scattare su questo opcode e questa forma
+    unsigned Shape = getOperandShape(*I);
+    Candidates.clear();
+    for (const LocalOptsRule *R : Index.lookup(I->getOpcode()))
+      if ((R->Shape & Shape) == R->Shape)
+        Candidates.push_back(R);
+    if (Candidates.empty())
+      continue;
+
+    if (rewrites >= LocalOptsMaxIterations) {
+      ++NumIterationCapHit;
+      LLVM_DEBUG(dbgs() << "LocalOpts: limite di " << LocalOptsMaxIterations
+                        << " riscritture raggiunto in " << B.getName()
+                        << "\n");
+      break;
+    }
+
+    collectBlockUsers(I);
+
+    // le Utility inseriscono le nuove istruzioni subito prima di I:
+    // tutto cio che sta tra Prev e I dopo la riscrittura e nuovo
+    Instruction *Prev = I->getPrevNode();
+
+    const LocalOptsRule *Fired = nullptr;
+    for (const LocalOptsRule *R : Candidates)
+      if (R->Apply(*I, A)) {
+        Fired = R;
+        break;
+      }
+    if (!Fired)
+      continue;
+    LLVM_DEBUG(dbgs() << "LocalOpts: regola " << Fired->Name << "\n");
 
-    blockChanged |= instructionChanged;
+    ++rewrites;
+    blockChanged = true;
+
+    for (Instruction *UI : Users)
+      Worklist.push(UI);
+
+    BasicBlock::iterator NewIt =
+        Prev ? std::next(Prev->getIterator()) : B.begin();
+    for (; &*NewIt != I; ++NewIt)
+      Worklist.push(&*NewIt);
+
+    // le Utility fanno sempre RAUW: I e morta, la cancello sul posto
+    // con la catena di operandi che moriva con lei
+    assert(I->use_empty() && "Istruzione riscritta ancora in uso");
+    eraseDead(I);
   }
-  // alla fine elimino le istruzioni che ho candidato
-  for (auto *I : toBeErased)
-    I->eraseFromParent();
+
+  // svuota il worklist se siamo usciti per il limite
+  while (!Worklist.isEmpty())
+    Worklist.removeOne();
 
   return blockChanged;
 }
 
+// Costanti intere lane per lane.
+// Uno scalare ConstantInt ha una sola lane; un vettore costante (splat o no)
+// ne ha una per elemento; un vettore scalable e accettato solo se splat
+// (una lane che vale per tutte). Fallisce se V non e una costante intera o
+// se qualche lane e undef/poison o un'espressione costante.
+static bool getConstLanes(Value *V, SmallVectorImpl<APInt> &Lanes) {
+  Lanes.clear();
+  if (auto *CI = dyn_cast<ConstantInt>(V)) {
+    Lanes.push_back(CI->getValue());
+    return true;
+  }
+  auto *C = dyn_cast<Constant>(V);
+  if (!C || !C->getType()->isIntOrIntVectorTy())
+    return false;
+
+  if (auto *VTy = dyn_cast<FixedVectorType>(C->getType())) {
+    for (unsigned i = 0, e = VTy->getNumElements(); i < e; ++i) {
+      auto *Elt = dyn_cast_or_null<ConstantInt>(C->getAggregateElement(i));
+      if (!Elt)
+        return false;
+      Lanes.push_back(Elt->getValue());
+    }
+    return true;
+  }
+
+  if (auto *Splat = dyn_cast_or_null<ConstantInt>(C->getSplatValue())) {
+    Lanes.push_back(Splat->getValue());
+    return true;
+  }
+  return false;
+}
+
+// Ricostruisce una costante del tipo Ty (scalare o vettore) dalle lane.
+// Se le lane sono tutte uguali si ottiene uno splat.
+static Constant *getLanesConst(Type *Ty, ArrayRef<APInt> Lanes) {
+  bool uniform = llvm::all_of(Lanes, [&](const APInt &L) {
+    return L == Lanes.front();
+  });
+  if (uniform)
+    return ConstantInt::get(Ty, Lanes.front());
+
+  SmallVector<Constant *, 8> Elts;
+  for (const APInt &L : Lanes)
+    Elts.push_back(ConstantInt::get(Ty->getScalarType(), L));
+  return ConstantVector::get(Elts);
+}
+
+// V come costante intera (scalare o vettore con lane ben definite), o nullptr
+static Constant *getIntConst(Value *V) {
+  SmallVector<APInt, 4> Lanes;
+  return getConstLanes(V, Lanes) ? cast<Constant>(V) : nullptr;
+}
+
+// Vero se V e una costante intera e ogni sua lane vale 0 / 1
+static bool isZeroConst(Value *V) {
+  SmallVector<APInt, 4> Lanes;
+  return getConstLanes(V, Lanes) &&
+         llvm::all_of(Lanes, [](const APInt &L) { return L.isZero(); });
+}
+
+static bool isOneConst(Value *V) {
+  SmallVector<APInt, 4> Lanes;
+  return getConstLanes(V, Lanes) &&
+         llvm::all_of(Lanes, [](const APInt &L) { return L.isOne(); });
+}
+
 bool LocalOpts::AlgebraicIdentityOpt2(Instruction &I) {
-  errs() << "\nRunning on AlgebricIdentityOpt:" << "\n";
   auto opCode = I.getOpcode();
   // cerco le tipologie di istruzione corrette
+  // le costanti possono essere scalari o vettori (splat o lane per lane)
   auto Op1 = I.getOperand(0);
   auto Op2 = I.getOperand(1);
   switch (opCode) {
@@ -62,20 +491,19 @@ bool LocalOpts::AlgebraicIdentityOpt2(Instruction &I) {
     // COMMUTATIVITY = true
     // NEUTRAL = 0
     // casi: (N+0), (0+N)
-    auto *C1 = dyn_cast<ConstantInt>(Op1);
-    auto *C2 = dyn_cast<ConstantInt>(Op2);
-    if (C1 && C1->isZero()) {
+    if (isZeroConst(Op1)) {
       // l'istruzione è un'identita
       I.replaceAllUsesWith(Op2);
-      errs() << "ADD opt! Op1=0\n";
+      ++NumAddIdentity;
+      LLVM_DEBUG(dbgs() << "ADD opt! Op1=0: " << I << "\n");
       return true;
     }
-    if (C2 && C2->isZero()) {
+    if (isZeroConst(Op2)) {
       I.replaceAllUsesWith(Op1);
-      errs() << "ADD opt! Op2=0\n";
+      ++NumAddIdentity;
+      LLVM_DEBUG(dbgs() << "ADD opt! Op2=0: " << I << "\n");
       return true;
     }
-    errs() << "No ADD opt.\n";
     return false;
   }
 
@@ -83,14 +511,12 @@ bool LocalOpts::AlgebraicIdentityOpt2(Instruction &I) {
     // COMMUTATIVITY = false
     // NEUTRAL = 0
     // casi: (N-0), (0+N)
-    auto *C1 = dyn_cast<ConstantInt>(Op1);
-    auto *C2 = dyn_cast<ConstantInt>(Op2);
-    if (C2 && C2->isZero()) {
+    if (isZeroConst(Op2)) {
       I.replaceAllUsesWith(Op1);
-      errs() << "SUB opt! Op2=0\n";
+      ++NumSubIdentity;
+      LLVM_DEBUG(dbgs() << "SUB opt! Op2=0: " << I << "\n");
       return true;
     }
-    errs() << "No SUB opt.\n";
     return false;
   }
 
@@ -98,18 +524,18 @@ bool LocalOpts::AlgebraicIdentityOpt2(Instruction &I) {
     // COMMUTATY = true
     // MEUTRAL = 1
     // casi: (N*1), (1*N)
-    auto *C1 = dyn_cast<ConstantInt>(Op1);
-    auto *C2 = dyn_cast<ConstantInt>(Op2);
-    if (C1 && C1->isOne()) {
+    if (isOneConst(Op1)) {
       // l'istruzione è un'identita
       I.replaceAllUsesWith(Op2);
-      errs() << "MUL opt! Op1=1\n";
+      ++NumMulIdentity;
+      LLVM_DEBUG(dbgs() << "MUL opt! Op1=1: " << I << "\n");
       return true;
     }
-    if (C2 && C2->isOne()) {
+    if (isOneConst(Op2)) {
       // l'istruzione è un'identita
       I.replaceAllUsesWith(Op1);
-      errs() << "MUL opt! Op2=1\n";
+      ++NumMulIdentity;
+      LLVM_DEBUG(dbgs() << "MUL opt! Op2=1: " << I << "\n");
       return true;
     }
     return false;
@@ -119,11 +545,10 @@ bool LocalOpts::AlgebraicIdentityOpt2(Instruction &I) {
     // COMMUTATY = false
     // NEUTRO = 1
     // Casi: (N/1)
-    auto *C1 = dyn_cast<ConstantInt>(Op1);
-    auto *C2 = dyn_cast<ConstantInt>(Op2);
-    if (C2 && C2->isOne()) {
+    if (isOneConst(Op2)) {
       I.replaceAllUsesWith(Op1);
-      errs() << "SDIV opt! Op1=1\n";
+      ++NumSDivIdentity;
+      LLVM_DEBUG(dbgs() << "SDIV opt! Op1=1: " << I << "\n");
       return true;
     }
     return false;
@@ -131,10 +556,10 @@ bool LocalOpts::AlgebraicIdentityOpt2(Instruction &I) {
 
   case Instruction::UDiv: {
     // logica comune
-    auto *C2 = dyn_cast<ConstantInt>(Op2);
-    if (C2 && C2->isOne()) {
+    if (isOneConst(Op2)) {
       I.replaceAllUsesWith(Op1);
-      errs() << "DIV opt! RHS=1\n";
+      ++NumUDivIdentity;
+      LLVM_DEBUG(dbgs() << "DIV opt! RHS=1: " << I << "\n");
       return true;
     }
     return false;
@@ -147,46 +572,486 @@ bool LocalOpts::AlgebraicIdentityOpt2(Instruction &I) {
   }
 }
 
-bool LocalOpts::StrengthReductionOpt(Instruction &I) {
-  errs() << "\nRunning su StrengthReduction:" << "\n";
+// ---- Divisione per costante (Hacker's Delight, cap. 10) ----
+// Per un divisore d non banale esiste un "magic number" M tale che
+// n / d = mulh(n, M) >> s (con qualche correzione), dove mulh e la parte alta
+// del prodotto a 2*BW bit. Sostituisce la divisione con una moltiplicazione.
+
+namespace {
+struct SignedMagic {
+  APInt Magic;
+  unsigned Shift;
+};
+
+struct UnsignedMagic {
+  APInt Magic;
+  unsigned Shift;
+  bool IsAdd; // il magic non sta in BW bit: serve la correzione "add"
+};
+} // namespace
+
+// Magic per sdiv: d con |d| >= 2 (Hacker's Delight, "magic").
+static SignedMagic computeSignedMagic(const APInt &D) {
+  unsigned BW = D.getBitWidth();
+  APInt SignedMin = APInt::getSignedMinValue(BW);
+
+  APInt AD = D.abs();
+  APInt T = SignedMin + D.lshr(BW - 1);
+  APInt ANC = T - 1 - T.urem(AD); // |nc|
+  unsigned P = BW - 1;
+  APInt Q1 = SignedMin.udiv(ANC); // 2^p / |nc|
+  APInt R1 = SignedMin - Q1 * ANC;
+  APInt Q2 = SignedMin.udiv(AD); // 2^p / |d|
+  APInt R2 = SignedMin - Q2 * AD;
+  APInt Delta(BW, 0);
+  do {
+    ++P;
+    Q1 <<= 1;
+    R1 <<= 1;
+    if (R1.uge(ANC)) {
+      ++Q1;
+      R1 -= ANC;
+    }
+    Q2 <<= 1;
+    R2 <<= 1;
+    if (R2.uge(AD)) {
+      ++Q2;
+      R2 -= AD;
+    }
+    Delta = AD - R2;
+  } while (Q1.ult(Delta) || (Q1 == Delta && R1.isZero()));
+
+  APInt Magic = Q2 + 1;
+  if (D.isNegative())
+    Magic = -Magic;
+  return {Magic, P - BW};
+}
+
+// Magic per udiv: d >= 2 (Hacker's Delight, "magicu").
+static UnsignedMagic computeUnsignedMagic(const APInt &D) {
+  unsigned BW = D.getBitWidth();
+  APInt AllOnes = APInt::getAllOnes(BW);
+  APInt SignedMin = APInt::getSignedMinValue(BW);
+  APInt SignedMax = APInt::getSignedMaxValue(BW);
+  bool IsAdd = false;
+
+  APInt NC = AllOnes - (AllOnes - D).urem(D);
+  unsigned P = BW - 1;
+  APInt Q1 = SignedMin.udiv(NC); // 2^p / nc
+  APInt R1 = SignedMin - Q1 * NC;
+  APInt Q2 = SignedMax.udiv(D); // (2^p - 1) / d
+  APInt R2 = SignedMax - Q2 * D;
+  APInt Delta(BW, 0);
+  do {
+    ++P;
+    if (R1.uge(NC - R1)) {
+      Q1 = Q1 + Q1 + 1;
+      R1 = R1 + R1 - NC;
+    } else {
+      Q1 = Q1 + Q1;
+      R1 = R1 + R1;
+    }
+    if ((R2 + 1).uge(D - R2)) {
+      if (Q2.uge(SignedMax))
+        IsAdd = true;
+      Q2 = Q2 + Q2 + 1;
+      R2 = R2 + R2 + 1 - D;
+    } else {
+      if (Q2.uge(SignedMin))
+        IsAdd = true;
+      Q2 = Q2 + Q2;
+      R2 = R2 + R2 + 1;
+    }
+    Delta = D - 1 - R2;
+  } while (P < BW * 2 && (Q1.ult(Delta) || (Q1 == Delta && R1.isZero())));
+
+  return {Q2 + 1, P - BW, IsAdd};
+}
+
+// Parte alta (BW bit) del prodotto X * M calcolato a 2*BW bit.
+// Signed: sext + mul + lshr + trunc; unsigned: zext al posto di sext.
+static Value *emitMulHigh(Value *X, ArrayRef<APInt> Magic, bool Signed,
+                          Instruction &I, const Twine &Name) {
+  Type *Ty = X->getType();
+  unsigned BW = Ty->getScalarSizeInBits();
+  Type *WideTy = Ty->getExtendedType();
+
+  SmallVector<APInt, 4> WideMagic;
+  for (const APInt &M : Magic)
+    WideMagic.push_back(Signed ? M.sext(2 * BW) : M.zext(2 * BW));
+
+  Value *WideX = CastInst::Create(Signed ? Instruction::SExt : Instruction::ZExt,
+                                  X, WideTy, Name + ".ext", &I);
+  Value *Prod = BinaryOperator::Create(Instruction::Mul, WideX,
+                                       getLanesConst(WideTy, WideMagic),
+                                       Name + ".mul", &I);
+  Value *Hi = BinaryOperator::Create(Instruction::LShr, Prod,
+                                     ConstantInt::get(WideTy, BW),
+                                     Name + ".hi", &I);
+  return CastInst::Create(Instruction::Trunc, Hi, Ty, Name, &I);
+}
+
+// adj = X + ((X >>a (BW-1)) & mask)
+// Per X < 0 aggiunge 2^k - 1, cosi lo shift aritmetico di k tronca verso
+// zero come sdiv. Usato da sdiv e srem per potenze di 2.
+static Value *emitSDivBias(Value *X, Constant *MaskC, Instruction &I,
+                           StringRef Prefix) {
+  Type *Ty = X->getType();
+  unsigned BitWidth = Ty->getScalarSizeInBits();
+
+  // sign = X >>_a (BitWidth - 1)  -> 0 se X>=0, -1 (tutti 1) se X<0
+  auto *ShAmtSign = ConstantInt::get(Ty, BitWidth - 1);
+  Value *Sign = BinaryOperator::Create(Instruction::AShr, X, ShAmtSign,
+                                       Prefix + ".sr.sign", &I);
+
+  // bias = sign & mask  -> 0 se X>=0, (2^shift - 1) se X<0
+  Value *Bias = BinaryOperator::Create(Instruction::And, Sign, MaskC,
+                                       Prefix + ".sr.bias", &I);
+
+  // adj = X + bias
+  return BinaryOperator::Create(Instruction::Add, X, Bias,
+                                Prefix + ".sr.adj", &I);
+}
+
+// Quoziente X sdiv C con il magic number, lane per lane.
+// Richiede |C| >= 2 su ogni lane e lo stesso tipo di correzione su tutte
+// (M e C di segno discorde -> +X / -X). Altrimenti nullptr.
+static Value *emitSDivMagic(Value *X, ArrayRef<APInt> C, Instruction &I,
+                            StringRef Prefix) {
+  Type *Ty = X->getType();
+  unsigned BW = Ty->getScalarSizeInBits();
+
+  SmallVector<APInt, 4> Magics, Shifts;
+  int Fix = 0; // +1: q += X, -1: q -= X
+  for (unsigned i = 0; i < C.size(); ++i) {
+    const APInt &D = C[i];
+    if (D.abs().ule(1))
+      return nullptr;
+    SignedMagic SM = computeSignedMagic(D);
+    int LaneFix = 0;
+    if (D.isStrictlyPositive() && SM.Magic.isNegative())
+      LaneFix = 1;
+    else if (D.isNegative() && SM.Magic.isStrictlyPositive())
+      LaneFix = -1;
+    if (i == 0)
+      Fix = LaneFix;
+    else if (LaneFix != Fix)
+      return nullptr;
+    Magics.push_back(SM.Magic);
+    Shifts.push_back(APInt(BW, SM.Shift));
+  }
+
+  // q = mulhs(X, M) (+/- X) >>a s
+  Value *Q = emitMulHigh(X, Magics, /*Signed=*/true, I, Prefix + ".sr.mulh");
+  if (Fix > 0)
+    Q = BinaryOperator::Create(Instruction::Add, Q, X, Prefix + ".sr.fix", &I);
+  else if (Fix < 0)
+    Q = BinaryOperator::Create(Instruction::Sub, Q, X, Prefix + ".sr.fix", &I);
+  Q = BinaryOperator::Create(Instruction::AShr, Q, getLanesConst(Ty, Shifts),
+                             Prefix + ".sr.ashr", &I);
+
+  // q += (q < 0): arrotonda verso zero i quozienti negativi
+  Value *SignBit = BinaryOperator::Create(Instruction::LShr, Q,
+                                          ConstantInt::get(Ty, BW - 1),
+                                          Prefix + ".sr.sign", &I);
+  return BinaryOperator::Create(Instruction::Add, Q, SignBit,
+                                Prefix + ".sr.quot", &I);
+}
+
+// Quoziente X udiv C con il magic number, lane per lane.
+// Richiede C >= 2 su ogni lane e lo stesso IsAdd su tutte. Altrimenti nullptr.
+static Value *emitUDivMagic(Value *X, ArrayRef<APInt> C, Instruction &I,
+                            StringRef Prefix) {
+  Type *Ty = X->getType();
+  unsigned BW = Ty->getScalarSizeInBits();
+
+  SmallVector<APInt, 4> Magics, Shifts;
+  bool IsAdd = false;
+  for (unsigned i = 0; i < C.size(); ++i) {
+    if (C[i].ule(1))
+      return nullptr;
+    UnsignedMagic UM = computeUnsignedMagic(C[i]);
+    if (i == 0)
+      IsAdd = UM.IsAdd;
+    else if (UM.IsAdd != IsAdd)
+      return nullptr;
+    Magics.push_back(UM.Magic);
+    // con IsAdd lo shift finale e s-1 (il primo bit lo toglie la media)
+    Shifts.push_back(APInt(BW, UM.IsAdd ? UM.Shift - 1 : UM.Shift));
+  }
+
+  Value *Q = emitMulHigh(X, Magics, /*Signed=*/false, I, Prefix + ".sr.mulh");
+  if (IsAdd) {
+    // q = (((X - q) >> 1) + q): media senza overflow
+    Value *NPQ =
+        BinaryOperator::Create(Instruction::Sub, X, Q, Prefix + ".sr.npq", &I);
+    NPQ = BinaryOperator::Create(Instruction::LShr, NPQ,
+                                 ConstantInt::get(Ty, 1),
+                                 Prefix + ".sr.npq.half", &I);
+    Q = BinaryOperator::Create(Instruction::Add, NPQ, Q, Prefix + ".sr.avg",
+                               &I);
+  }
+  return BinaryOperator::Create(Instruction::LShr, Q,
+                                getLanesConst(Ty, Shifts),
+                                Prefix + ".sr.quot", &I);
+}
+
+// La sequenza magic conviene solo se costa meno di I (div o rem per
+// costante) sul target: la parte alta si calcola a 2*BW bit (i128 per una
+// divisione i64) e le correzioni si contano tutte, due add/sub e due shift
+// in entrambi i casi; per il resto si aggiungono mul e sub finali.
+static bool magicDivIsCheaper(Instruction &I, bool Signed,
+                              const TargetTransformInfo &TTI) {
+  Type *Ty = I.getType();
+  Type *WideTy = Ty->getExtendedType();
+  auto Kind = TTI::TCK_RecipThroughput;
+  TTI::OperandValueInfo AnyOp = {TTI::OK_AnyValue, TTI::OP_None};
+  TTI::OperandValueInfo ConstOp = {TTI::OK_UniformConstantValue,
+                                   TTI::OP_None};
+
+  InstructionCost Seq =
+      TTI.getCastInstrCost(Signed ? Instruction::SExt : Instruction::ZExt,
+                           WideTy, Ty, TTI::CastContextHint::None, Kind) +
+      TTI.getArithmeticInstrCost(Instruction::Mul, WideTy, Kind, AnyOp,
+                                 ConstOp) +
+      TTI.getArithmeticInstrCost(Instruction::LShr, WideTy, Kind, AnyOp,
+                                 ConstOp) +
+      TTI.getCastInstrCost(Instruction::Trunc, Ty, WideTy,
+                           TTI::CastContextHint::None, Kind);
+  InstructionCost Shift = TTI.getArithmeticInstrCost(
+      Signed ? Instruction::AShr : Instruction::LShr, Ty, Kind, AnyOp, ConstOp);
+  InstructionCost AddSub =
+      TTI.getArithmeticInstrCost(Instruction::Add, Ty, Kind);
+  Seq += Shift * 2 + AddSub * 2;
+  if (I.getOpcode() == Instruction::SRem || I.getOpcode() == Instruction::URem)
+    Seq += TTI.getArithmeticInstrCost(Instruction::Mul, Ty, Kind, AnyOp,
+                                      ConstOp) +
+           AddSub;
+
+  InstructionCost DivCost = TTI.getArithmeticInstrCost(I.getOpcode(), Ty, Kind,
+                                                       AnyOp, ConstOp);
+  if (Seq.isValid() && Seq < DivCost)
+    return true;
+  ++NumDivKept;
+  LLVM_DEBUG(dbgs() << "DIV/REM kept, magic cost " << Seq
+                    << " >= div cost " << DivCost << ": " << I << "\n");
+  return false;
+}
+
+// ---- Moltiplicazione per costante come catena di shl/add/sub ----
+// Ricerca alla Bernstein: il costo di X * N si ottiene ricorsivamente da
+//   N pari:            (X * N/2^k) << k
+//   N dispari:         X * (N-1) + X,  X * (N+1) - X
+//   N = M * (2^k + 1): T + (T << k)     con T = X * M   (forme "lea")
+//   N = M * (2^k - 1): (T << k) - T
+// con memoizzazione su N. I costi dei singoli passi vengono da TTI, cosi
+// la catena si confronta con il costo della mul sul target corrente.
+
+namespace {
+class MulChainSynth {
+public:
+  enum StepKind { Leaf, Shl, AddX, SubX, AddShl, SubShl };
+
+  struct Step {
+    StepKind Kind = Leaf;
+    uint64_t Src = 1; // la catena calcola prima T = X * Src
+    unsigned Shift = 0;
+    InstructionCost Cost = 0;
+  };
+
+  MulChainSynth(const TargetTransformInfo &TTI, Type *Ty)
+      : BitWidth(Ty->getScalarSizeInBits()) {
+    // gli shift della catena sono sempre per una costante uniforme
+    TTI::OperandValueInfo AnyOp = {TTI::OK_AnyValue, TTI::OP_None};
+    TTI::OperandValueInfo ShAmtOp = {TTI::OK_UniformConstantValue,
+                                     TTI::OP_None};
+    auto Kind = TTI::TCK_RecipThroughput;
+    CostShl =
+        TTI.getArithmeticInstrCost(Instruction::Shl, Ty, Kind, AnyOp, ShAmtOp);
+    CostAdd = TTI.getArithmeticInstrCost(Instruction::Add, Ty, Kind);
+    CostSub = TTI.getArithmeticInstrCost(Instruction::Sub, Ty, Kind);
+  }
+
+  // Valori di N trattabili: ~0 e ~0-1 sono le chiavi vuota e tombstone di
+  // DenseMap<uint64_t>, e per i tipi da 64 bit in su N + 1 andrebbe a 0
+  static constexpr uint64_t MaxN = ~uint64_t(0) - 2;
+
+  // Catena piu economica per X * N (1 <= N <= MaxN)
+  Step solve(uint64_t N) {
+    if (N == 1)
+      return Step();
+    auto It = Memo.find(N);
+    if (It != Memo.end())
+      return It->second;
+
+    Step Best;
+    if (N % 2 == 0) {
+      // N pari: l'unica scelta sensata e togliere gli zeri in coda
+      unsigned K = countTrailingZeros(N);
+      Best = {Shl, N >> K, K, solve(N >> K).Cost + CostShl};
+    } else {
+      Best = {AddX, N - 1, 0, solve(N - 1).Cost + CostAdd};
+      // con 64 bit o piu maxValue() e ~0: N + 1 non deve uscire da MaxN
+      if (N < MaxN && N + 1 <= maxValue()) {
+        InstructionCost C = solve(N + 1).Cost + CostSub;
+        if (C < Best.Cost)
+          Best = {SubX, N + 1, 0, C};
+      }
+      // fattori 2^k +- 1; oltre il budget restano solo i passi +-1
+      // (anche per tipi piu larghi di 64 bit lo shift di P resta sotto 64)
+      for (unsigned K = 2; K < std::min(BitWidth, 64u) && Memo.size() < MaxNodes;
+           ++K) {
+        uint64_t P = uint64_t(1) << K;
+        if (P - 1 > N)
+          break;
+        if (N % (P + 1) == 0) {
+          InstructionCost C = solve(N / (P + 1)).Cost + CostShl + CostAdd;
+          if (C < Best.Cost)
+            Best = {AddShl, N / (P + 1), K, C};
+        }
+        if (N % (P - 1) == 0) {
+          InstructionCost C = solve(N / (P - 1)).Cost + CostShl + CostSub;
+          if (C < Best.Cost)
+            Best = {SubShl, N / (P - 1), K, C};
+        }
+      }
+    }
+    Memo[N] = Best;
+    return Best;
+  }
+
+  // Costo di X * N, oppure di X * -N se Negate. Una catena che termina con
+  // una sub si nega gratis scambiandone gli operandi.
+  InstructionCost cost(uint64_t N, bool Negate) {
+    Step S = solve(N);
+    if (Negate && S.Kind != SubX && S.Kind != SubShl)
+      return S.Cost + CostSub;
+    return S.Cost;
+  }
+
+  // Emette la catena davanti a I e ritorna X * N (o X * -N se Negate)
+  Value *emit(uint64_t N, bool Negate, Value *X, Instruction &I) {
+    Step S = solve(N);
+    if (Negate && (S.Kind == SubX || S.Kind == SubShl)) {
+      // A - B negato diventa B - A
+      Value *T = emitValue(S.Src, X, I);
+      Value *A = S.Kind == SubX ? T : emitShl(T, S.Shift, I);
+      Value *B = S.Kind == SubX ? X : T;
+      return BinaryOperator::Create(Instruction::Sub, B, A, "mul.sr.sub", &I);
+    }
+    Value *Res = emitValue(N, X, I);
+    return Negate ? BinaryOperator::CreateNeg(Res, "mul.sr.neg", &I) : Res;
+  }
+
+private:
+  // X * N senza negazione; Done riusa i valori intermedi gia emessi
+  Value *emitValue(uint64_t N, Value *X, Instruction &I) {
+    if (N == 1)
+      return X;
+    auto It = Done.find(N);
+    if (It != Done.end())
+      return It->second;
+
+    Step S = solve(N);
+    Value *T = emitValue(S.Src, X, I);
+    Value *Res = nullptr;
+    switch (S.Kind) {
+    case Shl:
+      Res = emitShl(T, S.Shift, I);
+      break;
+    case AddX:
+      Res = BinaryOperator::Create(Instruction::Add, T, X, "mul.sr.add", &I);
+      break;
+    case SubX:
+      Res = BinaryOperator::Create(Instruction::Sub, T, X, "mul.sr.sub", &I);
+      break;
+    case AddShl:
+      Res = BinaryOperator::Create(Instruction::Add, T, emitShl(T, S.Shift, I),
+                                   "mul.sr.add", &I);
+      break;
+    case SubShl:
+      Res = BinaryOperator::Create(Instruction::Sub, emitShl(T, S.Shift, I), T,
+                                   "mul.sr.sub", &I);
+      break;
+    case Leaf:
+      llvm_unreachable("N == 1 gestito sopra");
+    }
+    Done[N] = Res;
+    return Res;
+  }
+
+  Value *emitShl(Value *T, unsigned Shift, Instruction &I) {
+    return BinaryOperator::Create(Instruction::Shl, T,
+                                  ConstantInt::get(T->getType(), Shift),
+                                  "mul.sr.shl", &I);
+  }
+
+  uint64_t maxValue() const {
+    return BitWidth >= 64 ? ~uint64_t(0) : (uint64_t(1) << BitWidth) - 1;
+  }
+
+  // limite ai valori esplorati: la ricerca resta lineare nei bit
+  static constexpr unsigned MaxNodes = 256;
+
+  unsigned BitWidth;
+  InstructionCost CostShl, CostAdd, CostSub;
+  DenseMap<uint64_t, Step> Memo;
+  DenseMap<uint64_t, Value *> Done;
+};
+} // namespace
+
+bool LocalOpts::StrengthReductionOpt(Instruction &I,
+                                     const TargetTransformInfo &TTI) {
   auto opCode = I.getOpcode();
   // cerco le tipologie di istruzione corrette
   auto Op1 = I.getOperand(0);
   auto Op2 = I.getOperand(1);
+
+  // Interi scalari o vettori di interi (no float).
+  Type *Ty = I.getType();
+  if (!Ty->isIntOrIntVectorTy())
+    return false;
+  unsigned BitWidth = Ty->getScalarSizeInBits();
+
   switch (opCode) {
   case Instruction::Mul: {
     // COMMUTATIVA = true
     // è una mul?
-    // sono scalari/vettori e NON float? se vettore costante splat.
+    // sono scalari/vettori e NON float? i vettori sono trattati lane per lane
     // estrai op1 e op2
-    // se nessuno è constant int esci
+    // se nessuno è costante esci
     // prendi i valori in C e X
     // k = 2^k? fai shift
     // k != 2^k? fai
-    auto *C1 = dyn_cast<ConstantInt>(Op1);
-    auto *C2 = dyn_cast<ConstantInt>(Op2);
+    SmallVector<APInt, 4> L1, L2;
+    bool C1 = getConstLanes(Op1, L1);
+    bool C2 = getConstLanes(Op2, L2);
     if ((!C1 && !C2) || (C1 && C2)) {
       return false;
     }
-    ConstantInt *C = C1 ? C1 : C2;
+    ArrayRef<APInt> C = C1 ? L1 : L2;
     Value *X = C1 ? Op2 : Op1;
     // identità coperte da AlgebraicIdentity: 0, 1, -1
-    if (C->isZero() || C->isOne() || C->isMinusOne())
+    if (llvm::all_of(C, [](const APInt &L) {
+          return L.isZero() || L.isOne() || L.isAllOnes();
+        }))
       return false;
 
     // qui avrò una costante C e un valore X
-    // controllo se C è potenza di 2
-    APInt K = C->getValue().abs();
-    bool Neg = C->isNegative();
-    if (K.isPowerOf2()) {
-      // ottengo di quanto shiftare X
-      unsigned shift = K.logBase2();
-      Type *Ty = X->getType();
-      if (!Ty->isIntegerTy()) {
-        return false;
-      }
-      unsigned BitWidth = cast<IntegerType>(Ty)->getBitWidth();
-      auto *ShAmt = ConstantInt::get(cast<IntegerType>(Ty), shift);
+    // controllo se ogni lane di C è potenza di 2 (in modulo), con lo stesso
+    // segno su tutte le lane: il segno si gestisce con una sola neg finale
+    bool Neg = C.front().isNegative();
+    bool samesign = llvm::all_of(
+        C, [&](const APInt &L) { return L.isNegative() == Neg; });
+    bool allPow2 = llvm::all_of(
+        C, [](const APInt &L) { return L.abs().isPowerOf2(); });
+
+    if (samesign && allPow2) {
+      // ottengo di quanto shiftare X, lane per lane
+      SmallVector<APInt, 4> Shifts;
+      for (const APInt &L : C)
+        Shifts.push_back(APInt(BitWidth, L.abs().logBase2()));
+      auto *ShAmt = getLanesConst(Ty, Shifts);
       auto *Sh =
           BinaryOperator::Create(Instruction::Shl, X, ShAmt, "mul.sr.shl", &I);
       // a questo punto Sh vale (X<<shift)
@@ -197,33 +1062,41 @@ bool LocalOpts::StrengthReductionOpt(Instruction &I) {
         Res = BinaryOperator::CreateNeg(Sh, "mul.sr.neg", &I);
       }
       I.replaceAllUsesWith(Res);
-      errs() << "MUL strength-reduced to shift for pow2\n";
+      ++NumMulShl;
+      LLVM_DEBUG(dbgs() << "MUL strength-reduced to shift for pow2: " << I
+                        << "\n");
       return true;
     }
 
-    if (!K.isPowerOf2()) {
-      // calcolo la prima potenza di 2 superiore
-      unsigned shiftU = K.logBase2() + 1;
-      Type *Ty = X->getType();
-      if (!Ty->isIntegerTy()) {
-        return false;
-      }
-      unsigned BitWidth = cast<IntegerType>(Ty)->getBitWidth();
-      auto *ShAmt = ConstantInt::get(cast<IntegerType>(Ty), shiftU);
-      auto *Sh =
-          BinaryOperator::Create(Instruction::Shl, X, ShAmt, "mul.sr.shl", &I);
-      auto *Sub =
-          BinaryOperator::Create(Instruction::Sub, Sh, X, "mul.sr.shl.sub", &I);
-      // gestione del segno
-      Value *Res = Sub;
-      if (Neg) {
-        Res = BinaryOperator::CreateNeg(Sub, "mul.sr.neg.sub", &I);
-      }
-      I.replaceAllUsesWith(Res);
-      errs() << "MUL strength-reduced to shift for not pow2\n";
-      return true;
+    // non potenza di 2: catena di shl/add/sub, solo per costanti uniformi
+    // (scalari o splat) e solo se costa meno della mul sul target
+    bool uniform = llvm::all_of(
+        C, [&](const APInt &L) { return L == C.front(); });
+    APInt K = C.front().abs();
+    if (!uniform || K.getActiveBits() > 64 ||
+        K.getZExtValue() > MulChainSynth::MaxN)
+      return false;
+
+    MulChainSynth Synth(TTI, Ty);
+    InstructionCost ChainCost = Synth.cost(K.getZExtValue(), Neg);
+    TTI::OperandValueInfo AnyOp = {TTI::OK_AnyValue, TTI::OP_None};
+    TTI::OperandValueInfo ConstOp = {TTI::OK_UniformConstantValue,
+                                     TTI::OP_None};
+    InstructionCost MulCost = TTI.getArithmeticInstrCost(
+        Instruction::Mul, Ty, TTI::TCK_RecipThroughput, AnyOp, ConstOp);
+    if (!ChainCost.isValid() || !(ChainCost < MulCost)) {
+      ++NumMulKept;
+      LLVM_DEBUG(dbgs() << "MUL kept, chain cost " << ChainCost
+                        << " >= mul cost " << MulCost << ": " << I << "\n");
+      return false;
     }
-    return false;
+
+    Value *Res = Synth.emit(K.getZExtValue(), Neg, X, I);
+    I.replaceAllUsesWith(Res);
+    ++NumMulShiftAdd;
+    LLVM_DEBUG(dbgs() << "MUL strength-reduced to shl/add/sub chain: " << I
+                      << "\n");
+    return true;
   }
 
   case Instruction::SDiv: {
@@ -231,59 +1104,58 @@ bool LocalOpts::StrengthReductionOpt(Instruction &I) {
     Value *Op1 = I.getOperand(0); // X
     Value *Op2 = I.getOperand(1); // C (costante)
 
-    auto *C1 = dyn_cast<ConstantInt>(Op1);
-    auto *C2 = dyn_cast<ConstantInt>(Op2);
-    if (!C2 || C1)
+    SmallVector<APInt, 4> L1, C;
+    if (!getConstLanes(Op2, C) || getConstLanes(Op1, L1))
       return false; // costante deve stare a destra
 
-    ConstantInt *C = C2;
     Value *X = Op1;
 
-    // Solo interi scalari (no float, no vettori qui).
-    Type *ValTy = X->getType();
-    if (!ValTy->isIntegerTy())
-      return false;
-    auto *IntTy = cast<IntegerType>(ValTy);
-    unsigned BitWidth = IntTy->getBitWidth();
-    if (BitWidth == 0)
-      return false;
-
     // Esclusioni banali già coperte altrove o non trattabili qui.
-    if (C->isZero() || C->isOne() || C->isMinusOne())
+    if (llvm::all_of(C, [](const APInt &L) {
+          return L.isZero() || L.isOne() || L.isAllOnes();
+        }))
       return false;
-
-    // K = |C|; NegDivisor vero se C < 0
-    APInt K = C->getValue().abs();
-    bool NegDivisor = C->isNegative();
-
-    // Trattiamo solo divisori potenze di 2: K = 2^shift
-    if (!K.isPowerOf2())
+    if (llvm::any_of(C, [](const APInt &L) { return L.isZero(); }))
       return false;
 
-    unsigned shift = K.logBase2();
-    if (shift >= BitWidth)
-      return false; // evita shift fuori range
-
-    // ---- Bias per rispettare il troncamento verso 0 di sdiv ----
-    // mask = (1<<shift) - 1   (stessa width di X)
-    APInt MaskAP = (APInt(BitWidth, 1).shl(shift)) - APInt(BitWidth, 1);
-    auto *MaskC = ConstantInt::get(IntTy, MaskAP);
-
-    // sign = X >>_a (BitWidth - 1)  -> 0 se X>=0, -1 (tutti 1) se X<0
-    auto *ShAmtSign = ConstantInt::get(IntTy, BitWidth - 1);
-    Value *Sign = BinaryOperator::Create(Instruction::AShr, X, ShAmtSign,
-                                         "sdiv.sr.sign", &I);
+    // |C| lane per lane; NegDivisor vero se C < 0 (uguale su tutte le lane)
+    bool NegDivisor = C.front().isNegative();
+    bool samesign = llvm::all_of(C, [&](const APInt &L) {
+      return L.isNegative() == NegDivisor;
+    });
+    bool allPow2 = llvm::all_of(
+        C, [](const APInt &L) { return L.abs().isPowerOf2(); });
+
+    // Divisore qualsiasi: moltiplicazione per il magic number
+    if (!samesign || !allPow2) {
+      if (!magicDivIsCheaper(I, /*Signed=*/true, TTI))
+        return false;
+      Value *Quot = emitSDivMagic(X, C, I, "sdiv");
+      if (!Quot)
+        return false;
+      I.replaceAllUsesWith(Quot);
+      ++NumSDivMagic;
+      LLVM_DEBUG(dbgs() << "SDIV strength-reduced to magic multiply: " << I
+                        << "\n");
+      return true;
+    }
 
-    // bias = sign & mask  -> 0 se X>=0, (2^shift - 1) se X<0
-    Value *Bias = BinaryOperator::Create(Instruction::And, Sign, MaskC,
-                                         "sdiv.sr.bias", &I);
+    // Divisori potenze di 2: |C| = 2^shift su ogni lane
+    SmallVector<APInt, 4> Shifts, Masks;
+    for (const APInt &L : C) {
+      unsigned shift = L.abs().logBase2();
+      if (shift >= BitWidth)
+        return false; // evita shift fuori range
+      Shifts.push_back(APInt(BitWidth, shift));
+      // mask = (1<<shift) - 1   (stessa width di X)
+      Masks.push_back(APInt::getLowBitsSet(BitWidth, shift));
+    }
 
-    // adj = X + bias
-    Value *Adj =
-        BinaryOperator::Create(Instruction::Add, X, Bias, "sdiv.sr.adj", &I);
+    // ---- Bias per rispettare il troncamento verso 0 di sdiv ----
+    Value *Adj = emitSDivBias(X, getLanesConst(Ty, Masks), I, "sdiv");
 
     // quot = adj >>_a shift
-    auto *ShAmtK = ConstantInt::get(IntTy, shift);
+    auto *ShAmtK = getLanesConst(Ty, Shifts);
     Value *Quot = BinaryOperator::Create(Instruction::AShr, Adj, ShAmtK,
                                          "sdiv.sr.ashr", &I);
 
@@ -293,23 +1165,131 @@ bool LocalOpts::StrengthReductionOpt(Instruction &I) {
                    : (Value *)Quot;
 
     I.replaceAllUsesWith(Res);
-    errs() << "SDIV strength-reduced to arithmetic right shift with bias\n";
+    ++NumSDivBiasShift;
+    LLVM_DEBUG(dbgs() << "SDIV strength-reduced to ashr with bias: " << I
+                      << "\n");
     return true;
   }
-  default:
-    return false;
+
+  case Instruction::UDiv: {
+    // X / C unsigned, C costante a destra
+    SmallVector<APInt, 4> L1, C;
+    if (!getConstLanes(Op2, C) || getConstLanes(Op1, L1))
+      return false;
+    Value *X = Op1;
+
+    // 0 e 1: UB / identità (AlgebraicIdentity)
+    if (llvm::any_of(C, [](const APInt &L) { return L.isZero(); }) ||
+        llvm::all_of(C, [](const APInt &L) { return L.isOne(); }))
+      return false;
+
+    // potenze di 2: shift logico
+    if (llvm::all_of(C, [](const APInt &L) { return L.isPowerOf2(); })) {
+      SmallVector<APInt, 4> Shifts;
+      for (const APInt &L : C)
+        Shifts.push_back(APInt(BitWidth, L.logBase2()));
+      Value *Res = BinaryOperator::Create(
+          Instruction::LShr, X, getLanesConst(Ty, Shifts), "udiv.sr.lshr", &I);
+      I.replaceAllUsesWith(Res);
+      ++NumUDivShr;
+      LLVM_DEBUG(dbgs() << "UDIV strength-reduced to lshr: " << I << "\n");
+      return true;
+    }
+
+    if (!magicDivIsCheaper(I, /*Signed=*/false, TTI))
+      return false;
+    Value *Quot = emitUDivMagic(X, C, I, "udiv");
+    if (!Quot)
+      return false;
+    I.replaceAllUsesWith(Quot);
+    ++NumUDivMagic;
+    LLVM_DEBUG(dbgs() << "UDIV strength-reduced to magic multiply: " << I
+                      << "\n");
+    return true;
   }
 
+  case Instruction::URem:
+  case Instruction::SRem: {
+    // X % C, C costante a destra
+    bool Signed = opCode == Instruction::SRem;
+    StringRef Prefix = Signed ? "srem" : "urem";
+    SmallVector<APInt, 4> L1, C;
+    if (!getConstLanes(Op2, C) || getConstLanes(Op1, L1))
+      return false;
+    Value *X = Op1;
 
-}
+    // divisori 0 (UB) e +-1 (resto sempre 0) non li trattiamo qui
+    if (llvm::any_of(C, [](const APInt &L) { return L.abs().ule(1); }))
+      return false;
 
+    // urem per potenze di 2: X & (C - 1)
+    if (!Signed && llvm::all_of(C, [](const APInt &L) {
+          return L.isPowerOf2();
+        })) {
+      SmallVector<APInt, 4> Masks;
+      for (const APInt &L : C)
+        Masks.push_back(L - 1);
+      Value *Res = BinaryOperator::Create(
+          Instruction::And, X, getLanesConst(Ty, Masks), "urem.sr.and", &I);
+      I.replaceAllUsesWith(Res);
+      ++NumURemAnd;
+      LLVM_DEBUG(dbgs() << "UREM strength-reduced to and: " << I << "\n");
+      return true;
+    }
 
+    // srem per potenze di 2: X - ((X + bias) & -2^k)
+    // il segno del divisore non conta, il resto ha il segno di X
+    if (Signed && llvm::all_of(C, [](const APInt &L) {
+          return L.abs().isPowerOf2();
+        })) {
+      SmallVector<APInt, 4> Masks, HighMasks;
+      for (const APInt &L : C) {
+        unsigned shift = L.abs().logBase2();
+        Masks.push_back(APInt::getLowBitsSet(BitWidth, shift));
+        HighMasks.push_back(~Masks.back());
+      }
+      Value *Adj = emitSDivBias(X, getLanesConst(Ty, Masks), I, Prefix);
+      Value *Trunc =
+          BinaryOperator::Create(Instruction::And, Adj,
+                                 getLanesConst(Ty, HighMasks),
+                                 "srem.sr.round", &I);
+      Value *Res =
+          BinaryOperator::Create(Instruction::Sub, X, Trunc, "srem.sr", &I);
+      I.replaceAllUsesWith(Res);
+      ++NumSRemPow2;
+      LLVM_DEBUG(dbgs() << "SREM strength-reduced for pow2: " << I << "\n");
+      return true;
+    }
+
+    // divisore qualsiasi: X - (X / C) * C con la divisione magic
+    // la mul resta nel worklist e viene ridotta a sua volta se conviene
+    if (!magicDivIsCheaper(I, Signed, TTI))
+      return false;
+    Value *Quot = Signed ? emitSDivMagic(X, C, I, Prefix)
+                         : emitUDivMagic(X, C, I, Prefix);
+    if (!Quot)
+      return false;
+    Value *Prod = BinaryOperator::Create(Instruction::Mul, Quot, Op2,
+                                         Prefix + ".sr.mul", &I);
+    Value *Res =
+        BinaryOperator::Create(Instruction::Sub, X, Prod, Prefix + ".sr", &I);
+    I.replaceAllUsesWith(Res);
+    ++NumRemMagic;
+    LLVM_DEBUG(dbgs() << "REM strength-reduced to x - (x / C) * C: " << I
+                      << "\n");
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
 
 bool LocalOpts::MultiInstructionOpt(Instruction &I) {
   // I = (x + C) - C → x
 
-  // Lavoriamo solo su interi (no float/vettori).
-  if (!I.getType()->isIntegerTy())
+  // Lavoriamo solo su interi, scalari o vettori (no float).
+  if (!I.getType()->isIntOrIntVectorTy())
     return false;
 
   auto *OuterBO = dyn_cast<BinaryOperator>(&I);
@@ -325,7 +1305,8 @@ bool LocalOpts::MultiInstructionOpt(Instruction &I) {
   Value *OR = I.getOperand(1);
 
   // Funzione di utilità: controlla se due costanti sono davvero uguali
-  auto sameConst = [](const ConstantInt *A, const ConstantInt *B) -> bool {
+  // (per i vettori il confronto è lane per lane)
+  auto sameConst = [](Constant *A, Constant *B) -> bool {
     // Se almeno una non è una costante, non sono uguali
     if (!A || !B)
       return false;
@@ -335,7 +1316,8 @@ bool LocalOpts::MultiInstructionOpt(Instruction &I) {
       return false;
 
     // Devono avere lo stesso valore numerico
-    if (A->getValue() != B->getValue())
+    SmallVector<APInt, 4> LA, LB;
+    if (!getConstLanes(A, LA) || !getConstLanes(B, LB) || LA != LB)
       return false;
 
     // Tutti i controlli passati: sono la stessa costante
@@ -349,7 +1331,7 @@ bool LocalOpts::MultiInstructionOpt(Instruction &I) {
     // ---------- Pattern 1: (x + C) - C -> x ----------
     // outer = Sub( InnerAdd , Cout )
 
-    auto *Cout = dyn_cast<ConstantInt>(OR);
+    auto *Cout = getIntConst(OR);
     // operando destro della SUB (C), prendo costante
 
     auto *InnerAdd = dyn_cast<BinaryOperator>(OL);
@@ -359,9 +1341,9 @@ bool LocalOpts::MultiInstructionOpt(Instruction &I) {
       // Normalizza l'Add: costante a destra se necessario
       Value *IL = InnerAdd->getOperand(0); // candidato x
       Value *IR = InnerAdd->getOperand(1); // candidato C_in
-      ConstantInt *Cin = dyn_cast<ConstantInt>(IR);
+      Constant *Cin = getIntConst(IR);
       if (!Cin) {
-        if (auto *CinL = dyn_cast<ConstantInt>(IL)) {
+        if (auto *CinL = getIntConst(IL)) {
           std::swap(IL, IR);
           Cin = CinL;
         }
@@ -369,7 +1351,9 @@ bool LocalOpts::MultiInstructionOpt(Instruction &I) {
 
       if (Cin && sameConst(Cin, Cout)) {
         // Se gli operandi Cin e Cout coincidono allora abbiamo il pattern
-        errs() << "MultiInstr (add-sub): (x + C) - C -> x  | " << I << "\n";
+        ++NumAddSubFold;
+        LLVM_DEBUG(dbgs() << "MultiInstr (add-sub): (x + C) - C -> x  | "
+                          << I << "\n");
         I.replaceAllUsesWith(IL);   // IL è x dopo normalizzazione
         return true;
       }
@@ -377,14 +1361,16 @@ bool LocalOpts::MultiInstructionOpt(Instruction &I) {
 
     // ---------- Pattern 2: C - (C - x) -> x ----------
     // outer = Sub( Cout , InnerSub ) con InnerSub = Sub( Cin , X )
-    if (auto *Cout2 = dyn_cast<ConstantInt>(OL)) {
+    if (auto *Cout2 = getIntConst(OL)) {
       if (auto *InnerSub = dyn_cast<BinaryOperator>(OR)) {
         if (InnerSub->getOpcode() == Instruction::Sub) {
           Value *IL2 = InnerSub->getOperand(0); // atteso Cin
           Value *IR2 = InnerSub->getOperand(1); // atteso x
-          auto *Cin2 = dyn_cast<ConstantInt>(IL2); // costante davanti
+          auto *Cin2 = getIntConst(IL2); // costante davanti
           if (Cin2 && sameConst(Cin2, Cout2)) {
-            errs() << "MultiInstr (front-sub): C - (C - x) -> x  | " << I << "\n";
+            ++NumSubSubFold;
+            LLVM_DEBUG(dbgs() << "MultiInstr (front-sub): C - (C - x) -> x  | "
+                              << I << "\n");
             I.replaceAllUsesWith(IR2); // IR2 è x
             return true;
           }
@@ -399,14 +1385,14 @@ bool LocalOpts::MultiInstructionOpt(Instruction &I) {
     // ---------- Pattern 3: (x - C) + C -> x ----------
     // outer = Add( InnerSub , Cout )
     // Per Add normalizziamo: se la costante è a sinistra, la spostiamo a destra
-    ConstantInt *Cout = nullptr;
+    Constant *Cout = nullptr;
     Value *OLn = OL; // candidato Inner
     Value *ORn = OR; // candidato costante
 
-    if ((Cout = dyn_cast<ConstantInt>(OLn))) {
+    if ((Cout = getIntConst(OLn))) {
       std::swap(OLn, ORn); // metto la costante a destra
     }
-    if (!Cout) Cout = dyn_cast<ConstantInt>(ORn);
+    if (!Cout) Cout = getIntConst(ORn);
     if (!Cout) break; // niente costante, niente match
 
     // L'operando non costante (sinistro) deve essere una Sub
@@ -417,12 +1403,14 @@ bool LocalOpts::MultiInstructionOpt(Instruction &I) {
     // In Sub l'ordine conta: vogliamo Sub(X, Cin) con costante a destra
     Value *IL = InnerSub->getOperand(0);     // X
     Value *IR = InnerSub->getOperand(1);     // Cin
-    auto *Cin = dyn_cast<ConstantInt>(IR);
+    auto *Cin = getIntConst(IR);
     if (!Cin) break;
 
     // Stessa costante (tipo + valore) dentro e fuori
     if (sameConst(Cin, Cout)) {
-      errs() << "MultiInstr (sub-add): (x - C) + C -> x  | " << I << "\n";
+      ++NumSubAddFold;
+      LLVM_DEBUG(dbgs() << "MultiInstr (sub-add): (x - C) + C -> x  | "
+                        << I << "\n");
       I.replaceAllUsesWith(IL); // IL è x
       return true;
     }
@@ -435,4 +1423,615 @@ bool LocalOpts::MultiInstructionOpt(Instruction &I) {
   }
 
   return false; // se nessun caso è scattato
-}
\ No newline at end of file
+}
+
+
+// Riassociazione delle costanti su catene add/sub o mul:
+//   ((x + 4) + 8) - 2  ->  x + 10
+//   (x * 2) * 4        ->  x * 8
+// La catena si appiattisce in termini (con segno, per add/sub) e costanti;
+// le costanti si piegano in una sola e i termini si ricombinano in un albero
+// bilanciato. I nodi interni devono avere un solo uso ed essere nello stesso
+// blocco, cosi l'albero vecchio muore tutto con la radice.
+// Flag: nuw resta solo su catene di sole add tutte nuw (ogni somma parziale
+// di termini unsigned e <= del totale); in tutti gli altri casi nsw/nuw si
+// tolgono, perche le somme/prodotti parziali nuovi possono andare in overflow
+// anche quando quelli originali non lo facevano.
+bool LocalOpts::ReassociateOpt(Instruction &I) {
+  Type *Ty = I.getType();
+  if (!Ty->isIntOrIntVectorTy())
+    return false;
+
+  auto opCode = I.getOpcode();
+  bool isMul = opCode == Instruction::Mul;
+  if (!isMul && opCode != Instruction::Add && opCode != Instruction::Sub)
+    return false;
+
+  unsigned BitWidth = Ty->getScalarSizeInBits();
+  // limite ai nodi visitati: catene lunghe senza costanti non diventano
+  // quadratiche
+  const unsigned MaxNodes = 64;
+
+  // costante accumulata, lane per lane (1 lane = scalare o splat)
+  SmallVector<APInt, 4> Acc = {APInt(BitWidth, isMul ? 1 : 0)};
+  auto accumulate = [&](ArrayRef<APInt> Lanes, bool Neg) {
+    if (Acc.size() == 1 && Lanes.size() > 1)
+      Acc.assign(Lanes.size(), Acc.front());
+    for (unsigned i = 0; i < Acc.size(); ++i) {
+      const APInt &L = Lanes.size() == 1 ? Lanes.front() : Lanes[i];
+      if (isMul)
+        Acc[i] *= L;
+      else if (Neg)
+        Acc[i] -= L;
+      else
+        Acc[i] += L;
+    }
+  };
+
+  // appiattimento con stack esplicito: (valore, negato)
+  SmallVector<Value *, 8> Pos, NegTerms;
+  SmallVector<std::pair<Value *, bool>, 8> Stack = {{&I, false}};
+  unsigned NumNodes = 0;
+  bool allNUW = true, anySub = false;
+  SmallVector<APInt, 4> Lanes;
+
+  while (!Stack.empty()) {
+    auto [V, Neg] = Stack.pop_back_val();
+
+    if (getConstLanes(V, Lanes)) {
+      accumulate(Lanes, Neg);
+      continue;
+    }
+
+    auto *BO = dyn_cast<BinaryOperator>(V);
+    bool inner = BO && BO->getType() == Ty &&
+                 (BO == &I || (BO->hasOneUse() &&
+                               BO->getParent() == I.getParent())) &&
+                 NumNodes < MaxNodes;
+    if (inner) {
+      auto innerOp = BO->getOpcode();
+      Value *L = BO->getOperand(0);
+      Value *R = BO->getOperand(1);
+
+      if (!isMul && (innerOp == Instruction::Add ||
+                     innerOp == Instruction::Sub)) {
+        ++NumNodes;
+        allNUW &= BO->hasNoUnsignedWrap();
+        anySub |= innerOp == Instruction::Sub;
+        Stack.push_back({L, Neg});
+        Stack.push_back({R, innerOp == Instruction::Sub ? !Neg : Neg});
+        continue;
+      }
+
+      if (isMul && innerOp == Instruction::Mul) {
+        ++NumNodes;
+        Stack.push_back({L, false});
+        Stack.push_back({R, false});
+        continue;
+      }
+
+      // nelle catene mul, shl X, C conta come X * 2^C
+      SmallVector<APInt, 4> ShAmt;
+      if (isMul && innerOp == Instruction::Shl && BO != &I &&
+          getConstLanes(R, ShAmt) &&
+          llvm::all_of(ShAmt, [&](const APInt &S) {
+            return S.ult(BitWidth);
+          })) {
+        ++NumNodes;
+        for (APInt &S : ShAmt)
+          S = APInt::getOneBitSet(BitWidth, S.getZExtValue());
+        accumulate(ShAmt, false);
+        Stack.push_back({L, false});
+        continue;
+      }
+    }
+
+    (Neg ? NegTerms : Pos).push_back(V);
+  }
+
+  // x - x si annulla: togli le coppie di termini uguali con segno opposto
+  for (auto It = NegTerms.begin(); It != NegTerms.end();) {
+    auto Match = llvm::find(Pos, *It);
+    if (Match == Pos.end()) {
+      ++It;
+      continue;
+    }
+    Pos.erase(Match);
+    It = NegTerms.erase(It);
+  }
+
+  bool accZero = llvm::all_of(Acc, [](const APInt &A) { return A.isZero(); });
+  bool accOne = llvm::all_of(Acc, [](const APInt &A) { return A.isOne(); });
+
+  // istruzioni dell'albero nuovo: deve essere piu piccolo del vecchio,
+  // il che succede solo se c'erano costanti da piegare
+  unsigned P = Pos.size(), N = NegTerms.size();
+  unsigned NewCount;
+  if (isMul)
+    NewCount = (accZero || P == 0) ? 0 : P - 1 + (accOne ? 0 : 1);
+  else if (P == 0)
+    NewCount = N == 0 ? 0 : N;
+  else
+    NewCount = P - 1 + N + (accZero ? 0 : 1);
+  if (NewCount >= NumNodes)
+    return false;
+
+  // albero bilanciato di profondita minima
+  bool keepNUW = !isMul && allNUW && !anySub;
+  auto combine = [&](Instruction::BinaryOps Op, Value *A, Value *B) {
+    auto *New = BinaryOperator::Create(Op, A, B, "reassoc", &I);
+    if (keepNUW)
+      New->setHasNoUnsignedWrap(true);
+    return New;
+  };
+  auto balanced = [&](SmallVectorImpl<Value *> &Vals,
+                      Instruction::BinaryOps Op) -> Value * {
+    while (Vals.size() > 1) {
+      SmallVector<Value *, 8> Next;
+      for (unsigned i = 0; i + 1 < Vals.size(); i += 2)
+        Next.push_back(combine(Op, Vals[i], Vals[i + 1]));
+      if (Vals.size() % 2)
+        Next.push_back(Vals.back());
+      Vals.swap(Next);
+    }
+    return Vals.front();
+  };
+
+  Constant *AccC = getLanesConst(Ty, Acc);
+  Value *Res;
+  if (isMul) {
+    if (accZero || P == 0)
+      Res = AccC;
+    else {
+      Res = balanced(Pos, Instruction::Mul);
+      if (!accOne)
+        Res = combine(Instruction::Mul, Res, AccC);
+    }
+  } else if (P == 0) {
+    // C - (n1 + n2 + ...)
+    Res = N == 0 ? (Value *)AccC
+                 : combine(Instruction::Sub, AccC,
+                           balanced(NegTerms, Instruction::Add));
+  } else {
+    Res = balanced(Pos, Instruction::Add);
+    if (N)
+      Res = combine(Instruction::Sub, Res,
+                    balanced(NegTerms, Instruction::Add));
+    if (!accZero)
+      Res = combine(Instruction::Add, Res, AccC);
+  }
+
+  I.replaceAllUsesWith(Res);
+  ++NumReassoc;
+  LLVM_DEBUG(dbgs() << "Reassociated constant chain (" << NumNodes
+                    << " -> " << NewCount << " instr): " << I << "\n");
+  return true;
+}
+
+// ---- Floating point ----
+// In FP un'identita vale solo se rispetta zeri con segno, NaN e
+// arrotondamento. Quelle che non li rispettano sono abilitate dai
+// FastMathFlags dell'istruzione:
+// - nsz: il segno di uno zero non conta (x + 0.0 -> x)
+// - arcp: si puo usare il reciproco anche se inesatto (x / 3.0)
+// - reassoc: (x op C1) op C2 -> x op (C1 op C2)
+
+// Costanti FP lane per lane, come getConstLanes per gli interi
+static bool getFPConstLanes(Value *V, SmallVectorImpl<APFloat> &Lanes) {
+  Lanes.clear();
+  if (auto *CF = dyn_cast<ConstantFP>(V)) {
+    Lanes.push_back(CF->getValueAPF());
+    return true;
+  }
+  auto *C = dyn_cast<Constant>(V);
+  if (!C || !C->getType()->isFPOrFPVectorTy())
+    return false;
+
+  if (auto *VTy = dyn_cast<FixedVectorType>(C->getType())) {
+    for (unsigned i = 0, e = VTy->getNumElements(); i < e; ++i) {
+      auto *Elt = dyn_cast_or_null<ConstantFP>(C->getAggregateElement(i));
+      if (!Elt)
+        return false;
+      Lanes.push_back(Elt->getValueAPF());
+    }
+    return true;
+  }
+
+  if (auto *Splat = dyn_cast_or_null<ConstantFP>(C->getSplatValue())) {
+    Lanes.push_back(Splat->getValueAPF());
+    return true;
+  }
+  return false;
+}
+
+static Constant *getFPLanesConst(Type *Ty, ArrayRef<APFloat> Lanes) {
+  bool uniform = llvm::all_of(Lanes, [&](const APFloat &L) {
+    return L.bitwiseIsEqual(Lanes.front());
+  });
+  if (uniform)
+    return ConstantFP::get(Ty, Lanes.front());
+
+  SmallVector<Constant *, 8> Elts;
+  for (const APFloat &L : Lanes)
+    Elts.push_back(ConstantFP::get(Ty->getContext(), L));
+  return ConstantVector::get(Elts);
+}
+
+// Vero se V e una costante FP e Pred vale su ogni lane
+static bool allFPLanes(Value *V, function_ref<bool(const APFloat &)> Pred) {
+  SmallVector<APFloat, 4> Lanes;
+  return getFPConstLanes(V, Lanes) && llvm::all_of(Lanes, Pred);
+}
+
+bool LocalOpts::FPAlgebraicIdentityOpt(Instruction &I) {
+  if (!I.getType()->isFPOrFPVectorTy())
+    return false;
+  auto Op1 = I.getOperand(0);
+  auto Op2 = I.getOperand(1);
+  bool NSZ = I.hasNoSignedZeros();
+
+  auto isOne = [](const APFloat &L) { return L.isExactlyValue(1.0); };
+
+  switch (I.getOpcode()) {
+  case Instruction::FAdd: {
+    // x + -0.0 -> x sempre (anche per x = +-0.0)
+    // x + +0.0 -> x solo con nsz: -0.0 + +0.0 = +0.0
+    auto isNeutral = [&](const APFloat &L) {
+      return L.isZero() && (L.isNegative() || NSZ);
+    };
+    if (allFPLanes(Op2, isNeutral)) {
+      I.replaceAllUsesWith(Op1);
+      ++NumFAddIdentity;
+      LLVM_DEBUG(dbgs() << "FADD opt! Op2=0.0: " << I << "\n");
+      return true;
+    }
+    if (allFPLanes(Op1, isNeutral)) {
+      I.replaceAllUsesWith(Op2);
+      ++NumFAddIdentity;
+      LLVM_DEBUG(dbgs() << "FADD opt! Op1=0.0: " << I << "\n");
+      return true;
+    }
+    return false;
+  }
+
+  case Instruction::FSub: {
+    // x - +0.0 -> x sempre, x - -0.0 -> x solo con nsz
+    if (allFPLanes(Op2, [&](const APFloat &L) {
+          return L.isZero() && (!L.isNegative() || NSZ);
+        })) {
+      I.replaceAllUsesWith(Op1);
+      ++NumFSubIdentity;
+      LLVM_DEBUG(dbgs() << "FSUB opt! Op2=0.0: " << I << "\n");
+      return true;
+    }
+    return false;
+  }
+
+  case Instruction::FMul: {
+    // x * 1.0 -> x: esatto per ogni x
+    if (allFPLanes(Op2, isOne)) {
+      I.replaceAllUsesWith(Op1);
+      ++NumFMulIdentity;
+      LLVM_DEBUG(dbgs() << "FMUL opt! Op2=1.0: " << I << "\n");
+      return true;
+    }
+    if (allFPLanes(Op1, isOne)) {
+      I.replaceAllUsesWith(Op2);
+      ++NumFMulIdentity;
+      LLVM_DEBUG(dbgs() << "FMUL opt! Op1=1.0: " << I << "\n");
+      return true;
+    }
+    return false;
+  }
+
+  case Instruction::FDiv: {
+    if (allFPLanes(Op2, isOne)) {
+      I.replaceAllUsesWith(Op1);
+      ++NumFDivIdentity;
+      LLVM_DEBUG(dbgs() << "FDIV opt! Op2=1.0: " << I << "\n");
+      return true;
+    }
+    return false;
+  }
+
+  default:
+    return false;
+  }
+}
+
+bool LocalOpts::FPStrengthReductionOpt(Instruction &I) {
+  Type *Ty = I.getType();
+  if (!Ty->isFPOrFPVectorTy())
+    return false;
+  auto Op1 = I.getOperand(0);
+  auto Op2 = I.getOperand(1);
+
+  switch (I.getOpcode()) {
+  case Instruction::FDiv: {
+    // x / C -> x * (1/C)
+    // esatto se 1/C e rappresentabile (C = +-2^k, non denormale);
+    // con arcp basta che 1/C sia un numero normale
+    SmallVector<APFloat, 4> C;
+    if (!getFPConstLanes(Op2, C))
+      return false;
+    bool exact = true;
+    SmallVector<APFloat, 4> Inv;
+    for (const APFloat &L : C) {
+      APFloat R(L.getSemantics());
+      if (!L.getExactInverse(&R)) {
+        if (!I.hasAllowReciprocal() || !L.isFiniteNonZero())
+          return false;
+        R = APFloat(L.getSemantics(), 1);
+        R.divide(L, APFloat::rmNearestTiesToEven);
+        if (!R.isNormal())
+          return false;
+        exact = false;
+      }
+      Inv.push_back(R);
+    }
+    auto *Mul = BinaryOperator::Create(Instruction::FMul, Op1,
+                                       getFPLanesConst(Ty, Inv),
+                                       "fdiv.sr.recip", &I);
+    Mul->copyFastMathFlags(&I);
+    I.replaceAllUsesWith(Mul);
+    if (exact)
+      ++NumFDivRecip;
+    else
+      ++NumFDivRecipArcp;
+    LLVM_DEBUG(dbgs() << "FDIV strength-reduced to reciprocal fmul"
+                      << (exact ? "" : " (arcp)") << ": " << I << "\n");
+    return true;
+  }
+
+  case Instruction::FMul: {
+    // x * 2.0 -> x + x, x * -1.0 -> fneg x: esatti per ogni x
+    Value *X = Op1;
+    Value *C = Op2;
+    if (!isa<Constant>(C))
+      std::swap(X, C);
+    if (isa<Constant>(X))
+      return false;
+
+    Instruction *Res;
+    if (allFPLanes(C, [](const APFloat &L) { return L.isExactlyValue(2.0); }))
+      Res = BinaryOperator::Create(Instruction::FAdd, X, X, "fmul.sr.add",
+                                   &I);
+    else if (allFPLanes(
+                 C, [](const APFloat &L) { return L.isExactlyValue(-1.0); }))
+      Res = UnaryOperator::CreateFNeg(X, "fmul.sr.neg", &I);
+    else
+      return false;
+    Res->copyFastMathFlags(&I);
+    I.replaceAllUsesWith(Res);
+    ++NumFMulSR;
+    LLVM_DEBUG(dbgs() << "FMUL strength-reduced: " << I << "\n");
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
+
+bool LocalOpts::FPReassociateOpt(Instruction &I) {
+  // (x op C1) op C2 -> x op (C1 op C2), con op = fadd/fmul.
+  // Serve reassoc su entrambe; per fadd anche nsz, perche la costante
+  // piegata puo far cambiare segno a uno zero
+  Type *Ty = I.getType();
+  auto opCode = I.getOpcode();
+  if (!Ty->isFPOrFPVectorTy() ||
+      (opCode != Instruction::FAdd && opCode != Instruction::FMul))
+    return false;
+
+  auto allowed = [&](Instruction *J) {
+    return J->hasAllowReassoc() &&
+           (opCode == Instruction::FMul || J->hasNoSignedZeros());
+  };
+  if (!allowed(&I))
+    return false;
+
+  // costante esterna C2 e operando interno (x op C1)
+  SmallVector<APFloat, 4> C2, C1;
+  Value *InnerV = I.getOperand(0);
+  if (!getFPConstLanes(I.getOperand(1), C2)) {
+    InnerV = I.getOperand(1);
+    if (!getFPConstLanes(I.getOperand(0), C2))
+      return false;
+  }
+  auto *Inner = dyn_cast<BinaryOperator>(InnerV);
+  if (!Inner || Inner->getOpcode() != opCode || !Inner->hasOneUse() ||
+      Inner->getParent() != I.getParent() || !allowed(Inner))
+    return false;
+
+  Value *X = Inner->getOperand(0);
+  if (!getFPConstLanes(Inner->getOperand(1), C1)) {
+    X = Inner->getOperand(1);
+    if (!getFPConstLanes(Inner->getOperand(0), C1))
+      return false;
+  }
+
+  // costante piegata lane per lane; splat contro vettore si allarga
+  unsigned NumLanes = std::max(C1.size(), C2.size());
+  SmallVector<APFloat, 4> Folded;
+  for (unsigned i = 0; i < NumLanes; ++i) {
+    APFloat L = C1.size() == 1 ? C1.front() : C1[i];
+    const APFloat &R = C2.size() == 1 ? C2.front() : C2[i];
+    if (opCode == Instruction::FAdd)
+      L.add(R, APFloat::rmNearestTiesToEven);
+    else
+      L.multiply(R, APFloat::rmNearestTiesToEven);
+    // niente overflow a inf o NaN: x * inf non e piu x * C1 * C2 per x = 0
+    if (!L.isFinite())
+      return false;
+    Folded.push_back(L);
+  }
+
+  auto *New = BinaryOperator::Create(
+      static_cast<Instruction::BinaryOps>(opCode), X,
+      getFPLanesConst(Ty, Folded), "freassoc", &I);
+  New->copyFastMathFlags(&I);
+  New->andIRFlags(Inner);
+  I.replaceAllUsesWith(New);
+  ++NumFPReassoc;
+  LLVM_DEBUG(dbgs() << "FP constant chain reassociated: " << I << "\n");
+  return true;
+}
+
+// ---- Riduzioni guidate da known bits e range ----
+// I fatti su un valore vengono da computeKnownBits (struttura dell'IR: zext,
+// and, shl, assume) e, per gli interi scalari, dal range calcolato da LVI
+// (i branch che dominano I: un indice di loop 0 <= i < n e non negativo).
+
+// Known bits di V nel punto CxtI, uniti al range LVI quando c'e
+static KnownBits getKnownBits(Value *V, Instruction &CxtI,
+                              const LocalOptsAnalyses &A) {
+  KnownBits Known = computeKnownBits(V, A.DL, /*Depth=*/0, A.AC, &CxtI, A.DT);
+  if (A.LVI && V->getType()->isIntegerTy()) {
+    // UndefAllowed=false: phi [undef, x] non deve prendere il range di x,
+    // altrimenti le riscritture sbagliano sui valori che portano undef
+    KnownBits R = A.LVI->getConstantRange(V, &CxtI, /*UndefAllowed=*/false)
+                      .toKnownBits();
+    // due fatti veri insieme: sono in contrasto solo in codice irraggiungibile
+    if (!Known.Zero.intersects(R.One) && !Known.One.intersects(R.Zero)) {
+      Known.Zero |= R.Zero;
+      Known.One |= R.One;
+    }
+  }
+  return Known;
+}
+
+bool LocalOpts::ValueTrackingSROpt(Instruction &I,
+                                   const LocalOptsAnalyses &A) {
+  Type *Ty = I.getType();
+  if (!Ty->isIntOrIntVectorTy())
+    return false;
+  auto opCode = I.getOpcode();
+  auto Op1 = I.getOperand(0);
+  auto Op2 = I.getOperand(1);
+
+  switch (opCode) {
+  case Instruction::SDiv:
+  case Instruction::SRem: {
+    // x >= 0 e C > 0: il segno non conta e la versione unsigned si riduce
+    // meglio (sdiv x, 2^k diventa un solo lshr invece di ashr/and/add/ashr)
+    SmallVector<APInt, 4> C;
+    if (!getConstLanes(Op2, C) ||
+        !llvm::all_of(C, [](const APInt &L) { return L.isStrictlyPositive(); }))
+      return false;
+    if (!getKnownBits(Op1, I, A).isNonNegative())
+      return false;
+
+    bool isDiv = opCode == Instruction::SDiv;
+    auto *New = BinaryOperator::Create(
+        isDiv ? Instruction::UDiv : Instruction::URem, Op1, Op2,
+        isDiv ? "sdiv.vt.udiv" : "srem.vt.urem", &I);
+    if (isDiv)
+      New->setIsExact(I.isExact());
+    I.replaceAllUsesWith(New);
+    ++NumSignedToUnsigned;
+    LLVM_DEBUG(dbgs() << "Signed div/rem with non-negative dividend: " << I
+                      << "\n");
+    return true;
+  }
+
+  case Instruction::UDiv:
+  case Instruction::URem: {
+    bool isDiv = opCode == Instruction::UDiv;
+    SmallVector<APInt, 4> C;
+    if (getConstLanes(Op2, C)) {
+      // x < C su ogni lane: x / C = 0, x % C = x
+      // (le altre costanti le riduce StrengthReductionOpt)
+      APInt MaxX = getKnownBits(Op1, I, A).getMaxValue();
+      if (!llvm::all_of(C, [&](const APInt &L) { return MaxX.ult(L); }))
+        return false;
+      I.replaceAllUsesWith(isDiv ? Constant::getNullValue(Ty) : Op1);
+      ++NumDivRemRange;
+      LLVM_DEBUG(dbgs() << "UDIV/UREM with dividend below divisor: " << I
+                        << "\n");
+      return true;
+    }
+
+    // divisore non costante ma potenza di 2 (o 0, che sarebbe UB)
+    if (!isKnownToBeAPowerOfTwo(Op2, A.DL, /*OrZero=*/true, /*Depth=*/0, A.AC,
+                                &I, A.DT))
+      return false;
+
+    if (!isDiv) {
+      // x % 2^k = x & (2^k - 1)
+      auto *Mask = BinaryOperator::Create(Instruction::Add, Op2,
+                                          Constant::getAllOnesValue(Ty),
+                                          "urem.vt.mask", &I);
+      auto *And =
+          BinaryOperator::Create(Instruction::And, Op1, Mask, "urem.vt.and",
+                                 &I);
+      I.replaceAllUsesWith(And);
+      ++NumURemPow2Val;
+      LLVM_DEBUG(dbgs() << "UREM by power-of-two value to and: " << I
+                        << "\n");
+      return true;
+    }
+
+    // x / 2^k = x >> k: k si legge da (P << k) con P = 2^p costante,
+    // altrimenti serve cttz, solo se sul target costa meno della udiv
+    Value *ShAmt = nullptr;
+    SmallVector<APInt, 4> P;
+    auto *Sh = dyn_cast<BinaryOperator>(Op2);
+    if (Sh && Sh->getOpcode() == Instruction::Shl &&
+        getConstLanes(Sh->getOperand(0), P) && P.size() == 1 &&
+        P.front().isPowerOf2()) {
+      ShAmt = Sh->getOperand(1);
+      if (!P.front().isOne())
+        ShAmt = BinaryOperator::Create(
+            Instruction::Add, ShAmt,
+            ConstantInt::get(Ty, P.front().logBase2()), "udiv.vt.shamt", &I);
+    } else {
+      auto Kind = TTI::TCK_RecipThroughput;
+      IntrinsicCostAttributes CttzAttrs(
+          Intrinsic::cttz, Ty, {Ty, Type::getInt1Ty(Ty->getContext())});
+      InstructionCost ShiftCost =
+          A.TTI.getIntrinsicInstrCost(CttzAttrs, Kind) +
+          A.TTI.getArithmeticInstrCost(Instruction::LShr, Ty, Kind);
+      if (ShiftCost >= A.TTI.getArithmeticInstrCost(Instruction::UDiv, Ty, Kind))
+        return false;
+      // cttz(0) e poison, ma la udiv per 0 era gia UB
+      IRBuilder<> Builder(&I);
+      ShAmt = Builder.CreateIntrinsic(Intrinsic::cttz, {Ty},
+                                      {Op2, Builder.getTrue()}, nullptr,
+                                      "udiv.vt.log2");
+    }
+    auto *Shr = BinaryOperator::Create(Instruction::LShr, Op1, ShAmt,
+                                       "udiv.vt.shr", &I);
+    Shr->setIsExact(I.isExact());
+    I.replaceAllUsesWith(Shr);
+    ++NumUDivPow2Val;
+    LLVM_DEBUG(dbgs() << "UDIV by power-of-two value to lshr: " << I << "\n");
+    return true;
+  }
+
+  case Instruction::And: {
+    // maschera ridondante: i bit che C azzera sono gia zero in x
+    // (and (zext i8 x), 255; and i, 1023 con 0 <= i < 1024)
+    Value *X = Op1;
+    SmallVector<APInt, 4> C;
+    if (!getConstLanes(Op2, C)) {
+      X = Op2;
+      if (!getConstLanes(Op1, C))
+        return false;
+    }
+    if (isa<Constant>(X))
+      return false;
+    KnownBits KX = getKnownBits(X, I, A);
+    if (!llvm::all_of(C, [&](const APInt &L) {
+          return (~L & ~KX.Zero).isZero();
+        }))
+      return false;
+    I.replaceAllUsesWith(X);
+    ++NumMaskRemoved;
+    LLVM_DEBUG(dbgs() << "Redundant mask removed: " << I << "\n");
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
@@ -12,19 +12,49 @@
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/LazyValueInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/ConstantRange.h"
+#include "llvm/Support/KnownBits.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/ADT/DenseMap.h"
+#include <optional>
+#include <tuple>
 
 namespace llvm {
 
+// Analisi a disposizione delle regole: TTI per i costi, known bits e
+// range (LVI) per i fatti sui valori. AC, DT e LVI possono mancare.
+struct LocalOptsAnalyses {
+  const TargetTransformInfo &TTI;
+  const DataLayout &DL;
+  AssumptionCache *AC = nullptr;
+  DominatorTree *DT = nullptr;
+  LazyValueInfo *LVI = nullptr;
+};
+
 class LocalOpts : public PassInfoMixin<LocalOpts> {
 public:
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM);
-  static bool runOnBasicBlock(BasicBlock &B);
+  static bool runOnBasicBlock(BasicBlock &B, const LocalOptsAnalyses &A);
   static bool AlgebraicIdentityOpt2(Instruction &I);
   static bool AlgebraicIdentityOpt(Instruction &I);
-  static bool StrengthReductionOpt(Instruction &I);
+  static bool StrengthReductionOpt(Instruction &I,
+                                   const TargetTransformInfo &TTI);
   static bool AdvancedMulSROpt(Instruction &I);
   static bool MultiInstructionOpt(Instruction &I);
   static bool SubMultiInstrOpt(Instruction &I);
+  static bool ReassociateOpt(Instruction &I);
+  static bool FPAlgebraicIdentityOpt(Instruction &I);
+  static bool FPStrengthReductionOpt(Instruction &I);
+  static bool FPReassociateOpt(Instruction &I);
+  static bool ValueTrackingSROpt(Instruction &I, const LocalOptsAnalyses &A);
 };
 }
 
@@ -0,0 +1,153 @@
+// LoopSROpt.cpp
+#include "llvm/Transforms/Utils/LoopSROpt.h"
+
+#define DEBUG_TYPE "loop-sr-opt"
+
+using namespace llvm;
+
+STATISTIC(NumIVProductReduced, "MUL/SHL di IV sostituite da una ricorrenza");
+STATISTIC(NumRecurrenceCreated, "PHI additive create negli header");
+STATISTIC(NumRecurrenceReused, "Ricorrenze gia presenti riusate");
+
+// Visita i loop dal piu interno al piu esterno (post-ordine del nido):
+// il corpo dei loop interni e quello eseguito piu volte
+llvm::PreservedAnalyses llvm::LoopSROpt::run(Function &F,
+                                             FunctionAnalysisManager &FAM) {
+  LLVM_DEBUG(dbgs() << "\nRunning LoopSROpt on function: " << F.getName()
+                    << "\n");
+  auto &LI = FAM.getResult<LoopAnalysis>(F);
+  auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  const DataLayout &DL = F.getParent()->getDataLayout();
+
+  bool functionChanged = false;
+  for (Loop *L : llvm::reverse(LI.getLoopsInPreorder()))
+    functionChanged |= runOnLoop(*L, SE, DL);
+
+  if (!functionChanged)
+    return llvm::PreservedAnalyses::all();
+  // solo istruzioni nuove o cancellate: CFG, dominatori e loop restano validi
+  PreservedAnalyses PA;
+  PA.preserveSet<CFGAnalyses>();
+  PA.preserve<LoopAnalysis>();
+  return PA;
+}
+
+// Se I e una mul/shl tra una IV di L e un valore invariante in L, ritorna la
+// sua ricorrenza affine {Start,+,Step}<L> (nullptr altrimenti)
+const SCEVAddRecExpr *LoopSROpt::getIVProduct(Instruction &I, Loop &L,
+                                              ScalarEvolution &SE) {
+  auto opCode = I.getOpcode();
+  if (opCode != Instruction::Mul && opCode != Instruction::Shl)
+    return nullptr;
+  if (!I.getType()->isIntegerTy() || !SE.isSCEVable(I.getType()))
+    return nullptr;
+
+  auto isIV = [&](Value *V) {
+    auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(V));
+    return AR && AR->getLoop() == &L;
+  };
+  Value *Op1 = I.getOperand(0);
+  Value *Op2 = I.getOperand(1);
+  // shl: la IV e sempre a sinistra, la quantita di shift e invariante
+  bool ivTimesInv = (isIV(Op1) && L.isLoopInvariant(Op2)) ||
+                    (opCode == Instruction::Mul && isIV(Op2) &&
+                     L.isLoopInvariant(Op1));
+  if (!ivTimesInv)
+    return nullptr;
+
+  auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&I));
+  if (!AR || AR->getLoop() != &L || !AR->isAffine() ||
+      AR->getStepRecurrence(SE)->isZero())
+    return nullptr;
+  return AR;
+}
+
+// Cuore della trasformazione su un loop:
+// - i candidati sono le mul/shl del loop per cui SCEV da una ricorrenza
+//   affine di L; anche dentro un sottoloop, dove sono invarianti
+// - ogni ricorrenza diventa una PHI nell'header: Start dal preheader,
+//   PHI + Step dal latch; Start e Step si espandono nel preheader
+// - ricorrenze uguali (anche una PHI gia presente) condividono la PHI
+// - la mul/shl e sostituita dalla PHI e cancellata con gli operandi morti
+// Il valore della PHI in ogni punto dominato dalla mul e quello
+// dell'iterazione corrente, quindi e corretto anche per gli usi fuori loop
+bool LoopSROpt::runOnLoop(Loop &L, ScalarEvolution &SE,
+                          const DataLayout &DL) {
+  BasicBlock *Preheader = L.getLoopPreheader();
+  BasicBlock *Latch = L.getLoopLatch();
+  if (!Preheader || !Latch) {
+    LLVM_DEBUG(dbgs() << "LoopSROpt: loop senza preheader o latch unico, "
+                         "serve loop-simplify\n");
+    return false;
+  }
+  BasicBlock *Header = L.getHeader();
+
+  // in ordine di programma; si trasformano a ritroso cosi una mul esterna
+  // rende morta quella interna invece di costruire due ricorrenze
+  SmallVector<WeakTrackingVH, 8> Candidates;
+  for (BasicBlock *BB : L.blocks())
+    for (Instruction &I : *BB)
+      if (getIVProduct(I, L, SE))
+        Candidates.push_back(&I);
+  if (Candidates.empty())
+    return false;
+
+  // ricorrenze gia disponibili nell'header
+  DenseMap<const SCEV *, PHINode *> Recurrences;
+  for (PHINode &PN : Header->phis())
+    if (SE.isSCEVable(PN.getType()))
+      Recurrences.try_emplace(SE.getSCEV(&PN), &PN);
+
+  SCEVExpander Expander(SE, DL, "loop.sr");
+  SmallVector<PHINode *, 4> Created;
+  bool loopChanged = false;
+
+  for (WeakTrackingVH &VH : llvm::reverse(Candidates)) {
+    auto *I = dyn_cast_or_null<Instruction>(VH);
+    if (!I)
+      continue; // cancellata insieme a una mul gia ridotta
+    const SCEVAddRecExpr *AR = getIVProduct(*I, L, SE);
+    if (!AR)
+      continue;
+
+    PHINode *&PN = Recurrences[AR];
+    if (PN) {
+      ++NumRecurrenceReused;
+    } else {
+      const SCEV *Start = AR->getStart();
+      const SCEV *Step = AR->getStepRecurrence(SE);
+      Instruction *InsertPt = Preheader->getTerminator();
+      // Start e Step si espandono nel preheader: devono essere calcolabili li
+      if (!Expander.isSafeToExpandAt(Start, InsertPt) ||
+          !Expander.isSafeToExpandAt(Step, InsertPt)) {
+        Recurrences.erase(AR);
+        continue;
+      }
+      Type *Ty = I->getType();
+      Value *StartV = Expander.expandCodeFor(Start, Ty, InsertPt);
+      Value *StepV = Expander.expandCodeFor(Step, Ty, InsertPt);
+
+      PN = PHINode::Create(Ty, 2, "loop.sr.iv", &Header->front());
+      auto *Next = BinaryOperator::CreateAdd(PN, StepV, "loop.sr.next",
+                                             Latch->getTerminator());
+      for (BasicBlock *Pred : predecessors(Header))
+        PN->addIncoming(Pred == Latch ? (Value *)Next : StartV, Pred);
+      Created.push_back(PN);
+      ++NumRecurrenceCreated;
+    }
+
+    LLVM_DEBUG(dbgs() << "LoopSROpt: " << *I << " -> " << PN->getName()
+                      << " = " << *AR << "\n");
+    I->replaceAllUsesWith(PN);
+    RecursivelyDeleteTriviallyDeadInstructions(I);
+    ++NumIVProductReduced;
+    loopChanged = true;
+  }
+
+  // una ricorrenza creata per una mul poi resa morta da un'altra resta
+  // un ciclo PHI/add senza usi
+  for (PHINode *PN : Created)
+    RecursivelyDeleteDeadPHINode(PN);
+
+  return loopChanged;
+}
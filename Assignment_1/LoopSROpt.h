@@ -0,0 +1,33 @@
+#ifndef LOOP_SR_OPT_H
+#define LOOP_SR_OPT_H
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+
+namespace llvm {
+
+// Strength reduction a livello di loop: mul/shl di una variabile di
+// induzione per un valore invariante diventano una ricorrenza additiva
+// (PHI nell'header + add nel latch), un add per iterazione invece di una mul
+class LoopSROpt : public PassInfoMixin<LoopSROpt> {
+public:
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM);
+  static bool runOnLoop(Loop &L, ScalarEvolution &SE, const DataLayout &DL);
+  static const SCEVAddRecExpr *getIVProduct(Instruction &I, Loop &L,
+                                            ScalarEvolution &SE);
+};
+}
+
+#endif
@@ -9,9 +9,10 @@ BC_OUT="test_out.bc"
 LL_OUT="test_out.ll"
 
 # Pipeline: mem2reg + tuo pass
-# (Opzionale) aggiungi adce per pulire istruzioni morte rimaste
+# (local-opts cancella da solo le istruzioni morte, adce non serve)
 PIPELINE="mem2reg,local-opts"
-# PIPELINE="mem2reg,local-opts,adce"
+# con la strength reduction dei loop (mul di IV -> PHI additive) prima:
+# PIPELINE="mem2reg,loop-simplify,loop-sr-opt,local-opts"
 
 # --- Checks ---
 if [[ ! -f "$SRC" ]]; then
@@ -1,6 +1,67 @@
 #include "llvm/Transforms/Utils/LICMopt.h"
 using namespace llvm;
 
+// DEBUG_TYPE: nome per -debug-only e -stats. Le trasformazioni aggiunte
+// all'hoisting (loop pass, versioning, unswitching, sinking, promozione)
+// tracciano su dbgs(): dentro loop-mssa(...) outs() finirebbe mescolato
+// all'IR scritto da opt -S
+#define DEBUG_TYPE "licm-opt"
+
+STATISTIC(NumLoopPassChanged, "Loop modificati dal driver come loop pass");
+STATISTIC(NumVersioned, "Loop duplicati con controlli di alias a runtime");
+STATISTIC(NumVersioningTooBig, "Versioning rifiutato: loop troppo grande");
+STATISTIC(NumVersioningNoChecks, "Versioning rifiutato: nessun controllo");
+STATISTIC(NumUnswitched, "Loop duplicati su una condizione invariante");
+STATISTIC(NumSunk, "Istruzioni affondate nelle uscite");
+STATISTIC(NumPromoted, "Puntatori promossi a registro");
+STATISTIC(NumPromotionAliasing, "Promozioni impedite da accessi con alias");
+STATISTIC(NumPromotionNotGuaranteed,
+          "Promozioni impedite da store non eseguite a ogni iterazione");
+
+// Costo massimo (TTI, size+latency) di un'istruzione eseguita in modo
+// speculativo nel preheader: solo lavoro economico esce da un ramo
+static cl::opt<unsigned> LICMoptSpeculationThreshold(
+    "licm-opt-speculation-threshold", cl::init(2), cl::Hidden,
+    cl::desc("Costo massimo di un'istruzione hoistata speculativamente"));
+
+// Versioning dei loop: quando l'hoisting e bloccato solo da puntatori che
+// possono fare alias, il loop si duplica dietro un controllo a runtime
+static cl::opt<bool> LICMoptVersioning(
+    "licm-opt-versioning", cl::init(false), cl::Hidden,
+    cl::desc("Duplica i loop con controlli di alias a runtime"));
+
+// Limite alla crescita del codice: istruzioni massime di un loop duplicato
+static cl::opt<unsigned> LICMoptVersioningThreshold(
+    "licm-opt-versioning-threshold", cl::init(100), cl::Hidden,
+    cl::desc("Dimensione massima di un loop da duplicare"));
+
+// Unswitching: un branch su una condizione invariante si decide una volta
+// nel preheader, scegliendo fra due copie del loop
+static cl::opt<bool> LICMoptUnswitch(
+    "licm-opt-unswitch", cl::init(false), cl::Hidden,
+    cl::desc("Duplica i loop sulle condizioni invarianti dei branch"));
+
+// Budget di crescita del codice: istruzioni che l'unswitching puo duplicare
+// in tutta la funzione (copie di copie comprese)
+static cl::opt<unsigned> LICMoptUnswitchThreshold(
+    "licm-opt-unswitch-threshold", cl::init(100), cl::Hidden,
+    cl::desc("Istruzioni massime duplicate dall'unswitching per funzione"));
+
+// Analisi che restano valide dopo il passo: il CFG non cambia (si spostano
+// solo istruzioni), quindi DominatorTree e LoopInfo restano corretti;
+// MemorySSA e ScalarEvolution sono aggiornate in runOnLoop. Il versioning
+// cambia il CFG ma aggiorna anch'esso DominatorTree e LoopInfo
+static PreservedAnalyses getLICMoptPreservedAnalyses(bool CFGChanged) {
+  PreservedAnalyses PA;
+  if (!CFGChanged)
+    PA.preserveSet<CFGAnalyses>();
+  PA.preserve<DominatorTreeAnalysis>();
+  PA.preserve<LoopAnalysis>();
+  PA.preserve<MemorySSAAnalysis>();
+  PA.preserve<ScalarEvolutionAnalysis>();
+  return PA;
+}
+
 // Driver del passo
 llvm::PreservedAnalyses LICMopt::run(Function &F, FunctionAnalysisManager &FAM) {
   outs() << "\nRunning LICMopt su funzione: " << F.getName() << "\n";
@@ -8,32 +69,337 @@ llvm::PreservedAnalyses LICMopt::run(Function &F, FunctionAnalysisManager &FAM)
   auto &LI = FAM.getResult<LoopAnalysis>(F);
   auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
 
-  bool changed = false;
+  // il versioning va fatto prima di tutto: aggiunge loop e blocchi, quindi
+  // le analisi della funzione (tranne DT e LoopInfo, aggiornate) si buttano
+  // e MemorySSA si ricostruisce sul codice duplicato
+  bool versioned = LICMoptVersioning && versionLoops(F, LI, DT, FAM);
+  if (versioned) {
+    PreservedAnalyses PA;
+    PA.preserve<DominatorTreeAnalysis>();
+    PA.preserve<LoopAnalysis>();
+    FAM.invalidate(F, PA);
+  }
+
+  // MemorySSA (costruita sopra AAManager) dice se una load e sovrascritta
+  auto &MSSA = FAM.getResult<MemorySSAAnalysis>(F).getMSSA();
+  // alias analysis per la promozione scalare
+  auto &AA = FAM.getResult<AAManager>(F);
+  // costi del target per la speculazione
+  auto &TTI = FAM.getResult<TargetIRAnalysis>(F);
+  // SCEV non serve al passo: se qualcuno l'ha gia calcolata la si aggiorna
+  auto *SE = FAM.getCachedResult<ScalarEvolutionAnalysis>(F);
 
-  // Ciclo sui loop top-level della funzione
-  for (Loop *L : LI) {
-    bool localChanged = runOnLoop(L, DT);
+  bool changed = versioned;
+  bool unswitched = false;
+
+  // Ciclo su tutto il nido di loop in post-ordine (figli prima dei padri):
+  // un'invariante sale al preheader del loop interno e poi, quando si
+  // visita il padre, continua a salire finche resta invariante
+  for (Loop *L : llvm::reverse(LI.getLoopsInPreorder())) {
+    bool localChanged = runOnLoop(L, LI, DT, MSSA, AA, TTI, SE);
     if (localChanged) {
       changed = true;
     }
   }
 
+  // l'unswitching chiude il passo: le condizioni diventate invarianti sono
+  // ormai fuori dai loop. Cambia il CFG senza aggiornare MemorySSA e SCEV,
+  // che si lasciano invalidare; DT e LoopInfo restano aggiornati
+  if (LICMoptUnswitch)
+    unswitched = unswitchLoops(F, LI, DT);
+  if (unswitched) {
+    outs() << "  [OK] Almeno un loop è stato modificato\n";
+    PreservedAnalyses PA;
+    PA.preserve<DominatorTreeAnalysis>();
+    PA.preserve<LoopAnalysis>();
+    return PA;
+  }
+
   if (changed) {
     outs() << "  [OK] Almeno un loop è stato modificato\n";
-    return PreservedAnalyses::none();
+    return getLICMoptPreservedAnalyses(versioned);
   }
 
   outs() << "  [FALLITO] Nessuna trasformazione applicata\n";
   return PreservedAnalyses::all();
 }
 
+// Driver come loop pass: il LoopPassManager visita gia il nido dall'interno
+// verso l'esterno e fornisce le analisi standard, cosi il passo gira nella
+// stessa pipeline di loop-rotate senza ricalcoli a livello di funzione.
+// Serve MemorySSA, quindi va eseguito dentro loop-mssa(...)
+PreservedAnalyses LICMopt::run(Loop &L, LoopAnalysisManager &LAM,
+                               LoopStandardAnalysisResults &AR,
+                               LPMUpdater &U) {
+  LLVM_DEBUG(dbgs() << "LICMopt su loop: " << L.getName() << "\n");
+
+  if (!AR.MSSA) {
+    LLVM_DEBUG(dbgs() << "  MemorySSA assente, usare loop-mssa(licm-opt)\n");
+    return PreservedAnalyses::all();
+  }
+
+  if (!runOnLoop(&L, AR.LI, AR.DT, *AR.MSSA, AR.AA, AR.TTI, &AR.SE))
+    return PreservedAnalyses::all();
+
+  ++NumLoopPassChanged;
+  LLVM_DEBUG(dbgs() << "  loop modificato: " << L.getName() << "\n");
+  // analisi standard dei loop pass (DT, LoopInfo, SCEV, AA...) piu il CFG
+  // e MemorySSA, che il LoopPassManager richiede aggiornata
+  // (versioning e unswitching sono solo nel driver di funzione: qui il CFG
+  // non cambia)
+  auto PA = getLoopPassPreservedAnalyses();
+  PA.preserveSet<CFGAnalyses>();
+  PA.preserve<MemorySSAAnalysis>();
+  return PA;
+}
+
+
+// ################################################################################
+// Versioning dei loop (modalita licm-opt-versioning):
+// se un loop interno accede a indirizzi invarianti (load da hoistare,
+// locazioni da promuovere) ma ci sono puntatori che possono fare alias con
+// essi, il loop si duplica. Nel vecchio preheader un controllo a runtime
+// verifica che i gruppi di puntatori di LoopAccessAnalysis non si
+// sovrappongano e sceglie la copia annotata con metadati noalias, dove
+// l'hoisting procede; l'originale resta come fallback.
+// Solo loop analizzabili da LoopAccessAnalysis, con pochi controlli e non
+// piu grandi di licm-opt-versioning-threshold istruzioni
+bool LICMopt::versionLoops(Function &F, LoopInfo &LI, DominatorTree &DT,
+                           FunctionAnalysisManager &FAM) {
+  auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  auto &LAIs = FAM.getResult<LoopAccessAnalysis>(F);
+
+  // c'e qualcosa da guadagnare solo se il loop legge o scrive a un
+  // indirizzo invariante
+  auto hasInvariantAccess = [](Loop *L) -> bool {
+    for (BasicBlock *BB : L->blocks())
+      for (Instruction &I : *BB)
+        if (Value *Ptr = getLoadStorePointerOperand(&I))
+          if (L->isLoopInvariant(Ptr))
+            return true;
+    return false;
+  };
+
+  auto loopSize = [](Loop *L) -> unsigned {
+    unsigned Size = 0;
+    for (BasicBlock *BB : L->blocks())
+      Size += BB->size();
+    return Size;
+  };
+
+  // prima si raccolgono i candidati: il versioning aggiunge loop a LI.
+  // Le due copie sono marcate per non duplicarle di nuovo
+  SmallVector<Loop *, 8> Candidates;
+  for (Loop *L : LI.getLoopsInPreorder())
+    // LoopVersioning costruisce le PHI di uscita su un solo exit block
+    if (L->isInnermost() && L->isLoopSimplifyForm() &&
+        L->getExitingBlock() && L->getUniqueExitBlock() &&
+        !getBooleanLoopAttribute(L, "llvm.loop.licm_versioning.disable") &&
+        hasInvariantAccess(L))
+      Candidates.push_back(L);
+
+  bool changed = false;
+  for (Loop *L : Candidates) {
+    if (loopSize(L) > LICMoptVersioningThreshold) {
+      ++NumVersioningTooBig;
+      LLVM_DEBUG(dbgs() << "Versioning di " << L->getName()
+                        << " rifiutato: loop troppo grande\n");
+      continue;
+    }
+
+    // il versioning unisce in PHI nelle uscite i valori usati dopo il loop
+    formLCSSARecursively(*L, DT, &LI, &SE);
+
+    const LoopAccessInfo &LAI = LAIs.getInfo(*L);
+    unsigned NumChecks = LAI.getNumRuntimePointerChecks();
+    // i controlli ci sono solo se LoopAccessAnalysis sa calcolare i limiti
+    // di ogni gruppo di puntatori; i metadati noalias legano solo gruppi
+    // confrontati fra loro, le dipendenze dentro un gruppo (load e store
+    // allo stesso indirizzo invariante) restano visibili all'alias analysis
+    if (NumChecks == 0 ||
+        NumChecks > VectorizerParams::RuntimeMemoryCheckThreshold) {
+      ++NumVersioningNoChecks;
+      LLVM_DEBUG(dbgs() << "Versioning di " << L->getName()
+                        << " rifiutato: nessun controllo a runtime utile\n");
+      continue;
+    }
+
+    LoopVersioning LVer(LAI, LAI.getRuntimePointerChecking()->getChecks(), L,
+                        &LI, &DT, &SE);
+    LVer.versionLoop();
+    LVer.annotateLoopWithNoAlias();
+    addStringMetadataToLoop(LVer.getVersionedLoop(),
+                            "llvm.loop.licm_versioning.disable");
+    addStringMetadataToLoop(LVer.getNonVersionedLoop(),
+                            "llvm.loop.licm_versioning.disable");
+    ++NumVersioned;
+    LLVM_DEBUG(dbgs() << "Versioned loop: " << L->getName() << " ("
+                      << NumChecks << " controlli di alias a runtime)\n");
+    changed = true;
+  }
+  return changed;
+}
+
+
+// ################################################################################
+// Unswitching (modalita licm-opt-unswitch):
+// un branch condizionale del loop la cui condizione e invariante (tipicamente
+// un icmp appena hoistato da runOnLoop) si sposta nel preheader: il loop si
+// duplica, la copia originale gira con la condizione vera e il clone con la
+// condizione falsa, e in ognuna gli usi della condizione diventano costanti
+// (il ramo morto lo elimina poi simplifycfg).
+// I loop si visitano dall'esterno: una condizione invariante anche nel loop
+// padre si decide fuori da tutto il nido. Ogni duplicazione consuma dal
+// budget licm-opt-unswitch-threshold le istruzioni del loop copiato, che
+// limita anche le copie di copie
+bool LICMopt::unswitchLoops(Function &F, LoopInfo &LI, DominatorTree &DT) {
+  unsigned Budget = LICMoptUnswitchThreshold;
+
+  auto loopSize = [](Loop *L) -> unsigned {
+    unsigned Size = 0;
+    for (BasicBlock *BB : L->blocks())
+      Size += BB->size();
+    return Size;
+  };
+
+  // le operazioni convergenti non si possono mettere sotto una condizione
+  // nuova: un loop che ne contiene non si duplica (come SimpleLoopUnswitch)
+  auto hasConvergentCall = [](Loop *L) -> bool {
+    return llvm::any_of(L->blocks(), [](BasicBlock *BB) {
+      return llvm::any_of(*BB, [](Instruction &I) {
+        auto *CB = dyn_cast<CallBase>(&I);
+        return CB && CB->isConvergent();
+      });
+    });
+  };
+
+  // primo branch su condizione invariante di un loop (sottoloop compresi).
+  // Si parte dopo runOnLoop: le condizioni che il punto fisso ha trovato
+  // invarianti sono gia state spostate nel preheader, quindi basta chiedere
+  // a LoopInfo se la condizione e definita fuori dal loop
+  auto findInvariantBranch = [](Loop *L) -> BranchInst * {
+    for (BasicBlock *BB : L->blocks()) {
+      auto *BI = dyn_cast<BranchInst>(BB->getTerminator());
+      if (!BI || !BI->isConditional() ||
+          BI->getSuccessor(0) == BI->getSuccessor(1))
+        continue;
+      Value *Cond = BI->getCondition();
+      // una condizione costante la risolve gia simplifycfg
+      if (!isa<Constant>(Cond) && L->isLoopInvariant(Cond))
+        return BI;
+    }
+    return nullptr;
+  };
+
+  bool changed = false;
+  // LoopInfo cambia a ogni duplicazione: si ricomincia la ricerca da capo
+  // finche c'e un candidato che sta nel budget
+  while (true) {
+    Loop *Target = nullptr;
+    BranchInst *TargetBI = nullptr;
+    for (Loop *L : LI.getLoopsInPreorder()) {
+      if (!L->isLoopSimplifyForm() || !L->isSafeToClone() ||
+          hasConvergentCall(L) || loopSize(L) > Budget)
+        continue;
+      if (BranchInst *BI = findInvariantBranch(L)) {
+        Target = L;
+        TargetBI = BI;
+        break;
+      }
+    }
+    if (!Target)
+      break;
+
+    Budget -= loopSize(Target);
+    ++NumUnswitched;
+    LLVM_DEBUG(dbgs() << "Unswitched loop: " << Target->getName() << " su "
+                      << *TargetBI->getCondition() << "\n");
+    unswitchLoop(Target, TargetBI, LI, DT);
+    changed = true;
+  }
+  return changed;
+}
+
+// Duplicazione di L sulla condizione di BI, sul modello di LoopVersioning:
+// il vecchio preheader diventa il blocco che testa la condizione, le due
+// copie si riuniscono nelle uscite (PHI LCSSA estese al clone) e poi ogni
+// loop riceve di nuovo uscite dedicate
+void LICMopt::unswitchLoop(Loop *L, BranchInst *BI, LoopInfo &LI,
+                           DominatorTree &DT) {
+  // i valori del loop usati fuori passano tutti per PHI nelle uscite
+  formLCSSARecursively(*L, DT, &LI, nullptr);
+
+  Value *Cond = BI->getCondition();
+  BasicBlock *CheckBB = L->getLoopPreheader();
+  BasicBlock *PH = SplitBlock(CheckBB, CheckBB->getTerminator(), &DT, &LI,
+                              nullptr, L->getHeader()->getName() + ".ph");
+  SmallVector<BasicBlock *, 8> ExitBlocks;
+  L->getUniqueExitBlocks(ExitBlocks);
+
+  ValueToValueMapTy VMap;
+  SmallVector<BasicBlock *, 16> NewBlocks;
+  Loop *NewLoop = cloneLoopWithPreheader(PH, CheckBB, L, VMap, ".us", &LI,
+                                         &DT, NewBlocks);
+  remapInstructionsInBlocks(NewBlocks, VMap);
+
+  // il test si fa una volta sola; se nel loop il branch poteva non essere
+  // raggiunto la condizione potrebbe essere poison: la si congela
+  Instruction *OrigTerm = CheckBB->getTerminator();
+  Value *Test = Cond;
+  if (!isGuaranteedNotToBeUndefOrPoison(Cond))
+    Test = new FreezeInst(Cond, Cond->getName() + ".fr", OrigTerm);
+  BranchInst::Create(PH, NewLoop->getLoopPreheader(), Test, OrigTerm);
+  OrigTerm->eraseFromParent();
+
+  // le uscite ora si raggiungono da entrambe le copie
+  for (BasicBlock *Exit : ExitBlocks)
+    for (PHINode &PN : Exit->phis())
+      for (unsigned i = 0, e = PN.getNumIncomingValues(); i != e; ++i) {
+        BasicBlock *Pred = PN.getIncomingBlock(i);
+        if (!L->contains(Pred))
+          continue;
+        Value *V = PN.getIncomingValue(i);
+        Value *NewV = VMap.lookup(V);
+        PN.addIncoming(NewV ? NewV : V, cast<BasicBlock>(VMap[Pred]));
+      }
+
+  // i blocchi fuori dal loop dominati da un blocco del loop (uscite e loro
+  // punti di unione) ora sono dominati dal blocco del test
+  SmallVector<BasicBlock *, 8> Reparent;
+  for (BasicBlock *BB : L->blocks())
+    for (DomTreeNode *Child : DT.getNode(BB)->children())
+      if (!L->contains(Child->getBlock()))
+        Reparent.push_back(Child->getBlock());
+  for (BasicBlock *BB : Reparent)
+    DT.changeImmediateDominator(BB, CheckBB);
+
+  // condizione vera nella copia originale, falsa nel clone
+  LLVMContext &Ctx = Cond->getContext();
+  for (Use &U : llvm::make_early_inc_range(Cond->uses())) {
+    auto *UI = dyn_cast<Instruction>(U.getUser());
+    if (!UI)
+      continue;
+    if (L->contains(UI))
+      U.set(ConstantInt::getTrue(Ctx));
+    else if (NewLoop->contains(UI))
+      U.set(ConstantInt::getFalse(Ctx));
+  }
+
+  formDedicatedExitBlocks(L, &DT, &LI, nullptr, /*PreserveLCSSA=*/true);
+  formDedicatedExitBlocks(NewLoop, &DT, &LI, nullptr, /*PreserveLCSSA=*/true);
+}
+
 
 // ################################################################################
 // Cuore operativo (LICM):
 // - visita i blocchi del loop
 // - individua istruzioni loop-invariant candidabili all'hoisting
 // - sposta le istruzioni nel preheader in modo sicuro
-bool LICMopt::runOnLoop(Loop *L, DominatorTree &DT) {
+// - promuove a registro le locazioni di memoria invarianti (promoteMemory)
+// - affonda nelle uscite cio che serve solo dopo il loop (sinkToExits)
+bool LICMopt::runOnLoop(Loop *L, LoopInfo &LI, DominatorTree &DT,
+                        MemorySSA &MSSA, AAResults &AA,
+                        const TargetTransformInfo &TTI, ScalarEvolution *SE) {
 
   if (!L) {
    outs() << "  [FALLITO] Loop nullo ricevuto in runOnLoop\n";
@@ -51,15 +417,39 @@ bool LICMopt::runOnLoop(Loop *L, DominatorTree &DT) {
   SetVector<Instruction *> movable, moved;
   // movable: insieme ordinato (di inserimento) di istruzioni che possiamo
   // spostare moved: insieme di ciò che è stato spostato
-  SmallVector<BasicBlock *> ExitBlocks;
-  // insieme di BB di uscita dal loop (servono per prove di dominanza in
-  // isSafeToMove
-  L->getExitBlocks(ExitBlocks);
-  // riempimento effettivo del vettore con i blocchi di uscita
+  LICMLoopSafety Safety;
+  // uscite, blocchi che le dominano tutte e istruzioni che possono lanciare:
+  // calcolati qui una volta sola, il CFG del loop non cambia durante il passo
+  computeLoopSafety(L, DT, Safety);
+
+  // una load (o una call che legge soltanto) e invariante se nessuna
+  // scrittura nel loop (store, call) puo toccare la memoria che legge: il
+  // walker di MemorySSA risale dall'accesso passando per la MemoryPhi
+  // dell'header (quindi anche lungo il backedge) e il primo clobber deve
+  // stare fuori dal loop
+  auto noClobberInLoop = [&](Instruction &I) -> bool {
+    MemoryAccess *Clobber = MSSA.getWalker()->getClobberingMemoryAccess(&I);
+    return MSSA.isLiveOnEntryDef(Clobber) ||
+           !L->contains(Clobber->getBlock());
+  };
+
+  // una call si tratta come un'operazione pura (strlen, abs, sqrt, funzioni
+  // __attribute__((const))) se termina sempre, non lancia eccezioni e non
+  // tocca la memoria, oppure la legge soltanto e il loop non la scrive
+  auto isPureCall = [&](CallInst &CI) -> bool {
+    if (isa<DbgInfoIntrinsic>(CI) || CI.isConvergent())
+      return false;
+    if (!CI.willReturn() || !CI.doesNotThrow())
+      return false;
+    if (CI.doesNotAccessMemory())
+      return true;
+    return CI.onlyReadsMemory() && noClobberInLoop(CI);
+  };
 
   auto isLoopInvariant = [&](Instruction &I) -> bool {
     // qui controlla se una istruzione dentro il loop è Loop-invariant:
-    // 1. accetta solo operatori binari
+    // 1. accetta operatori binari, GEP, cast, confronti, select, load e
+    //    call pure
     // 2. operandi:
     //      - costanti
     //      - istruzioni già riconosciute invarianti
@@ -67,9 +457,12 @@ bool LICMopt::runOnLoop(Loop *L, DominatorTree &DT) {
     //      - istruzioni NON dipendenti da PHI
     //      - istruzioni NON dipendenti da istruzioni non ancora invariant
 
-    if (!I.isBinaryOp())
-      // solo operazioni binarie (add,sub,mul...)
-      // NO a PHI, terminatori, load, store, call, cast, icmp
+    if (!I.isBinaryOp() && !isa<GetElementPtrInst>(I) && !isa<CastInst>(I) &&
+        !isa<CmpInst>(I) && !isa<SelectInst>(I) && !isa<LoadInst>(I) &&
+        !isa<CallInst>(I))
+      // operazioni binarie (add,sub,mul...), calcolo di indirizzi (GEP),
+      // sext/zext/trunc, icmp/fcmp, select, load e call pure
+      // NO a PHI, terminatori, store
       return false;
 
     for (Value *op : I.operands()) {
@@ -79,8 +472,10 @@ bool LICMopt::runOnLoop(Loop *L, DominatorTree &DT) {
       // se l'operando è costante o argomento di funzione è definito fuori da L
 
       if (auto *OpInst = dyn_cast<Instruction>(op)) {
-        if (isa<PHINode>(OpInst))
-          // niente PHI come dipendenze, legherebbe il valore all'iterazione
+        if (isa<PHINode>(OpInst) && L->contains(OpInst))
+          // niente PHI del loop come dipendenze, legherebbe il valore
+          // all'iterazione; la PHI di un loop esterno invece e fissa per
+          // tutta l'esecuzione di L
           return false;
 
         // se la dipendenza non è nel loop dove è definita?
@@ -93,46 +488,462 @@ bool LICMopt::runOnLoop(Loop *L, DominatorTree &DT) {
         return false;
       }
     }
+
+    // 3. una load deve anche leggere memoria che il loop non scrive
+    if (auto *Load = dyn_cast<LoadInst>(&I))
+      // niente load volatili o atomiche
+      return Load->isSimple() && noClobberInLoop(*Load);
+    // 4. una call deve essere pura (gli argomenti sono gli operandi sopra)
+    if (auto *CI = dyn_cast<CallInst>(&I))
+      return isPureCall(*CI);
     return true;
   };
 
 
-  // Scansione dei blocchi del loop e raccolta delle candidate
+  // Raccolta delle candidate con un worklist a punto fisso: si parte da
+  // tutte le istruzioni del loop in ordine DFS e, quando una diventa
+  // movable, i suoi utenti nel loop tornano in coda perche potrebbero
+  // esserlo anche loro. Cosi le catene di invarianti si trovano tutte in
+  // un solo giro, qualunque sia l'ordine dei blocchi. Un'istruzione supera
+  // isLoopInvariant solo quando tutti i suoi operandi sono gia decisi,
+  // quindi l'ordine di inserimento in movable mette gli operandi prima degli
+  // usi. La stessa istruzione puo essere in coda due volte (posto iniziale e
+  // utente di un operando spostato): decided fa si che isSafeToMove si
+  // chiami al piu una volta per istruzione
+  SmallVector<Instruction *, 64> Worklist;
   for (BasicBlock *BB : depth_first(L->getHeader())) {
     // depth_first(...) fa scansione in profondità dall'header in giù
     if (!L->contains(BB))
       continue;
     // solo blocchi nel loop (NO exit block o succ fuori)
+    for (Instruction &I : *BB)
+      Worklist.push_back(&I);
+  }
+  // la coda si svuota dal fondo: al contrario si visita in ordine DFS
+  std::reverse(Worklist.begin(), Worklist.end());
 
-    for (Instruction &I : *BB) {
-      // itera sulle istruzioni del I del BB
-      if (isLoopInvariant(I) && isSafeToMove(I, L, DT, ExitBlocks)) {
-        // controllo di candidabilità
-        movable.insert(&I);
-        // se positive al controllo si candidano
-        outs() << "Found movable loopInvariant: " << I << "\n";
-        // condizioni per una istruzione I
-        // 1. NO side-effect
-        // 2. deve dominare tutte le uscite
-        // 3. non deve essere invalidata da PHI
-        // 4. deve dominare tutti gli usi
-      }
-    }
+  // istruzioni hoistate in modo speculativo
+  SmallPtrSet<Instruction *, 8> speculated;
+  // invarianti gia passate da isSafeToMove, spostabili o no
+  SmallPtrSet<Instruction *, 32> decided;
+  while (!Worklist.empty()) {
+    Instruction *I = Worklist.pop_back_val();
+    if (decided.contains(I) || !isLoopInvariant(*I))
+      continue;
+    decided.insert(I);
+    bool Speculated;
+    if (!isSafeToMove(*I, L, DT, TTI, Safety, Speculated))
+      continue;
+    if (Speculated)
+      speculated.insert(I);
+    // condizioni per una istruzione I
+    // 1. NO side-effect
+    // 2. deve dominare tutte le uscite
+    // 3. non deve essere invalidata da PHI
+    // 4. deve dominare tutti gli usi
+    movable.insert(I);
+    outs() << "Found movable loopInvariant: " << *I << "\n";
+    for (User *U : I->users())
+      if (auto *UI = dyn_cast<Instruction>(U))
+        if (L->contains(UI) && !decided.contains(UI))
+          Worklist.push_back(UI);
   }
 
   // istruzione mossa
+  // le load si spostano anche in MemorySSA, che resta valida per i loop
+  // successivi
+  MemorySSAUpdater MSSAU(&MSSA);
   for (Instruction *I : movable) {
+    if (speculated.contains(I))
+      // !range, !nonnull, noundef... valevano solo dove I era eseguita:
+      // nel preheader trasformerebbero un poison in UB immediato
+      I->dropUBImplyingAttrsAndMetadata();
     I->moveBefore(preheader->getTerminator());
+    if (MemoryUseOrDef *MA = MSSA.getMemoryAccess(I))
+      MSSAU.moveToPlace(MA, preheader, MemorySSA::BeforeTerminator);
     moved.insert(I);
     outs() << "Moved to preheader: " << *I << "\n";
   }
 
-  if (moved.empty())
+  // dopo l'hoisting anche gli indirizzi calcolati nel loop (GEP) possono
+  // essere diventati invarianti
+  bool promoted = promoteMemory(L, DT, MSSA, AA, Safety);
+
+  // il caso opposto di deadOutsideLoopControll: valori usati solo dopo il
+  // loop non serve calcolarli a ogni iterazione
+  bool sunk = sinkToExits(L, DT, Safety);
+
+  if (moved.empty() && !promoted && !sunk)
     return false;
+
+  if (promoted)
+    // il valore promosso esce dal loop tramite le store nelle uscite:
+    // si ripristina la forma LCSSA richiesta dai loop pass
+    formLCSSARecursively(*L, DT, &LI, SE);
+  if (SE)
+    // le istruzioni spostate cambiano variante/invariante rispetto ai loop
+    // del nido; i valori cancellati (load promosse, istruzioni affondate)
+    // escono da SCEV con i loro value handle
+    SE->forgetLoopDispositions();
   return true;
 }
 
 
+// ################################################################################
+// Fatti del loop usati dai controlli di isSafeToMove e da promoteMemory.
+// I blocchi che dominano tutte le uscite sono l'intersezione, ristretta al
+// loop, delle catene di dominatori di ogni uscita: si risale l'albero una
+// volta per uscita invece di interrogarlo per ogni istruzione e ogni uscita.
+// Dominare le uscite non basta per dire che un blocco e eseguito: un cammino
+// puo tornare all'header senza passarci (for(;;) { if (p) { x = *p; if (x)
+// break; } }). Eseguito a ogni iterazione e solo chi domina anche i latch
+void LICMopt::computeLoopSafety(Loop *L, DominatorTree &DT,
+                                LICMLoopSafety &Safety) {
+  L->getExitBlocks(Safety.ExitBlocks);
+
+  // blocchi del loop sulla catena dei dominatori di BB
+  auto domChain = [&](DomTreeNode *N) {
+    SmallPtrSet<BasicBlock *, 16> Chain;
+    for (; N; N = N->getIDom()) {
+      BasicBlock *BB = N->getBlock();
+      if (L->contains(BB))
+        Chain.insert(BB);
+      if (BB == L->getHeader())
+        // sopra l'header si e fuori dal loop
+        break;
+    }
+    return Chain;
+  };
+
+  bool first = true;
+  for (BasicBlock *Exit : Safety.ExitBlocks) {
+    DomTreeNode *N = DT.getNode(Exit);
+    if (!N)
+      // uscita irraggiungibile: ogni blocco la domina
+      continue;
+    SmallPtrSet<BasicBlock *, 16> Chain = domChain(N);
+    if (first)
+      Safety.DominatesAllExits = std::move(Chain);
+    else
+      set_intersect(Safety.DominatesAllExits, Chain);
+    first = false;
+  }
+  // nessuna uscita raggiungibile (loop infinito): l'insieme resta vuoto.
+  // Dominare tutte le uscite vorrebbe dire "eseguita a ogni ingresso", che
+  // per un blocco condizionale di un loop infinito non e vero; come
+  // isGuaranteedToExecute si rinuncia al caso degenere
+
+  Safety.GuaranteedToExecute = Safety.DominatesAllExits;
+  SmallVector<BasicBlock *, 4> Latches;
+  L->getLoopLatches(Latches);
+  for (BasicBlock *Latch : Latches)
+    set_intersect(Safety.GuaranteedToExecute, domChain(DT.getNode(Latch)));
+
+  // una sola scansione del loop per le istruzioni che possono lanciare o
+  // non ritornare (call, load volatili...)
+  Safety.MayThrow = llvm::any_of(L->blocks(), [](BasicBlock *BB) {
+    return llvm::any_of(*BB, [](Instruction &I) {
+      return !isGuaranteedToTransferExecutionToSuccessor(&I);
+    });
+  });
+}
+
+
+// ################################################################################
+// Sinking verso le uscite:
+// un'istruzione del loop (non di un sottoloop) senza effetti collaterali
+// e senza accessi a memoria, i cui usi sono tutti fuori dal loop, viene
+// clonata in ogni blocco di uscita che domina e tolta dal loop.
+// - gli operandi ancora nel loop arrivano al clone tramite PHI LCSSA
+// - le PHI LCSSA che usavano I (tutti gli ingressi = I) diventano il clone
+// - gli altri usi fuori dal loop si riscrivono con SSAUpdater, che unisce i
+//   cloni di uscite diverse
+// I blocchi e le istruzioni si visitano al contrario: quando si arriva a un
+// operando, i suoi utenti sono gia fuori e l'intero albero scende insieme.
+bool LICMopt::sinkToExits(Loop *L, DominatorTree &DT,
+                          const LICMLoopSafety &Safety) {
+  if (!L->hasDedicatedExits())
+    return false;
+
+  const SmallVector<BasicBlock *> &ExitBlocks = Safety.ExitBlocks;
+  SmallPtrSet<BasicBlock *, 8> ExitSet(ExitBlocks.begin(), ExitBlocks.end());
+
+  auto inSubLoop = [&](BasicBlock *BB) -> bool {
+    for (Loop *Sub : L->getSubLoops())
+      if (Sub->contains(BB))
+        return true;
+    return false;
+  };
+
+  // PHI LCSSA in un'uscita che riceve I da tutti i predecessori
+  auto isTrivialLCSSA = [&](PHINode *PN, Instruction &I) -> bool {
+    return ExitSet.count(PN->getParent()) &&
+           llvm::all_of(PN->incoming_values(),
+                        [&](Value *V) { return V == &I; });
+  };
+
+  auto canSink = [&](Instruction &I) -> bool {
+    if (isa<PHINode>(I) || I.isTerminator() || I.isEHPad() ||
+        isa<AllocaInst>(I) || I.mayHaveSideEffects() ||
+        I.mayReadFromMemory() || I.use_empty())
+      return false;
+    for (Use &U : I.uses()) {
+      auto *UI = cast<Instruction>(U.getUser());
+      if (L->contains(UI))
+        return false;
+      // un uso in PHI vale alla fine del blocco di provenienza: se e nel
+      // loop, la PHI deve essere LCSSA banale per poterla sostituire
+      if (auto *PN = dyn_cast<PHINode>(UI))
+        if (L->contains(PN->getIncomingBlock(U)) && !isTrivialLCSSA(PN, I))
+          return false;
+    }
+    return true;
+  };
+
+  // valore di OpI (definito nel loop) all'ingresso di Exit
+  auto getLCSSAPhi = [&](Instruction *OpI, BasicBlock *Exit) -> Value * {
+    for (PHINode &PN : Exit->phis())
+      if (isTrivialLCSSA(&PN, *OpI))
+        return &PN;
+    auto *PN = PHINode::Create(OpI->getType(), pred_size(Exit),
+                               OpI->getName() + ".lcssa", &Exit->front());
+    for (BasicBlock *Pred : predecessors(Exit))
+      PN->addIncoming(OpI, Pred);
+    return PN;
+  };
+
+  SmallVector<BasicBlock *, 16> Blocks;
+  for (BasicBlock *BB : depth_first(L->getHeader()))
+    if (L->contains(BB) && !inSubLoop(BB))
+      Blocks.push_back(BB);
+
+  bool changed = false;
+  for (BasicBlock *BB : llvm::reverse(Blocks)) {
+    for (Instruction &I : llvm::make_early_inc_range(llvm::reverse(*BB))) {
+      if (!canSink(I))
+        continue;
+
+      // un clone in ogni uscita dominata da I (le altre non portano agli usi)
+      SmallMapVector<BasicBlock *, Instruction *, 4> Clones;
+      for (BasicBlock *Exit : ExitBlocks) {
+        if (Clones.count(Exit) || !DT.dominates(I.getParent(), Exit))
+          continue;
+        Instruction *C = I.clone();
+        C->setName(I.getName() + ".sink");
+        C->insertBefore(&*Exit->getFirstInsertionPt());
+        for (Use &Op : C->operands())
+          if (auto *OpI = dyn_cast<Instruction>(Op.get()))
+            if (L->contains(OpI))
+              Op.set(getLCSSAPhi(OpI, Exit));
+        Clones[Exit] = C;
+      }
+      if (Clones.empty())
+        continue;
+
+      // prima le PHI LCSSA, poi gli altri usi con SSAUpdater
+      SmallSetVector<PHINode *, 4> LCSSAPhis;
+      for (User *U : I.users())
+        if (auto *PN = dyn_cast<PHINode>(U))
+          if (isTrivialLCSSA(PN, I))
+            LCSSAPhis.insert(PN);
+      for (PHINode *PN : LCSSAPhis) {
+        PN->replaceAllUsesWith(Clones[PN->getParent()]);
+        PN->eraseFromParent();
+      }
+
+      SSAUpdater SSA;
+      SSA.Initialize(I.getType(), I.getName());
+      for (auto &Entry : Clones)
+        SSA.AddAvailableValue(Entry.first, Entry.second);
+      for (Use &U : llvm::make_early_inc_range(I.uses()))
+        SSA.RewriteUse(U);
+
+      ++NumSunk;
+      LLVM_DEBUG(dbgs() << "Sunk to " << Clones.size()
+                        << " exit block(s): " << I << "\n");
+      I.eraseFromParent();
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+
+namespace {
+// Riscrive un gruppo di load/store allo stesso puntatore: SSAUpdater
+// sostituisce ogni load con il valore disponibile in quel punto, le store
+// spariscono e il valore finale si scrive una volta in ogni uscita.
+// MemorySSA segue le istruzioni create e cancellate.
+class LoopPromoter : public LoadAndStorePromoter {
+public:
+  LoopPromoter(ArrayRef<const Instruction *> Insts, SSAUpdater &S,
+               Value *Ptr, ArrayRef<BasicBlock *> ExitBlocks, Align Alignment,
+               MemorySSAUpdater &MSSAU)
+      : LoadAndStorePromoter(Insts, S, Ptr->getName()), Ptr(Ptr),
+        ExitBlocks(ExitBlocks), Alignment(Alignment), MSSAU(MSSAU) {}
+
+  void doExtraRewritesBeforeFinalDeletion() override {
+    for (BasicBlock *Exit : ExitBlocks) {
+      Value *LiveOut = SSA.GetValueInMiddleOfBlock(Exit);
+      auto *NewSI = new StoreInst(LiveOut, Ptr, /*isVolatile=*/false,
+                                  Alignment, &*Exit->getFirstInsertionPt());
+      MemoryAccess *MA = MSSAU.createMemoryAccessInBB(
+          NewSI, nullptr, Exit, MemorySSA::Beginning);
+      MSSAU.insertDef(cast<MemoryDef>(MA), /*RenameUses=*/true);
+    }
+  }
+
+  void instructionDeleted(Instruction *I) const override {
+    MSSAU.removeMemoryAccess(I);
+  }
+
+private:
+  Value *Ptr;
+  ArrayRef<BasicBlock *> ExitBlocks;
+  Align Alignment;
+  MemorySSAUpdater &MSSAU;
+};
+} // namespace
+
+
+// ################################################################################
+// Promozione scalare (register promotion):
+// per ogni puntatore P invariante nel loop su cui il loop fa store
+// - tutti gli accessi del loop che possono toccare P devono essere load/store
+//   semplici must-alias a P con lo stesso tipo (niente call o altri accessi
+//   che possono fare alias)
+// - una store a P deve essere eseguita a ogni iterazione (domina uscite e
+//   latch, niente istruzioni che lanciano): allora leggere P nel preheader e
+//   riscriverlo nelle uscite non introduce accessi nuovi. In alternativa P
+//   e un'alloca mai catturata (nessun altro thread la vede) e dereferenziabile
+// se valgono: load di P nel preheader, valore portato in PHI da SSAUpdater,
+// store nei blocchi di uscita
+bool LICMopt::promoteMemory(Loop *L, DominatorTree &DT, MemorySSA &MSSA,
+                            AAResults &AA, const LICMLoopSafety &Safety) {
+  const SmallVector<BasicBlock *> &ExitBlocks = Safety.ExitBlocks;
+  BasicBlock *preheader = L->getLoopPreheader();
+  if (!L->hasDedicatedExits()) {
+    // le uscite devono avere predecessori solo nel loop (loop-simplify)
+    LLVM_DEBUG(dbgs() << "Promozione: uscite non dedicate\n");
+    return false;
+  }
+  for (BasicBlock *Exit : ExitBlocks)
+    if (Exit->getFirstInsertionPt() == Exit->end())
+      return false;
+
+  const DataLayout &DL = preheader->getModule()->getDataLayout();
+
+  auto accessedType = [](Instruction &I) -> Type * {
+    if (auto *Load = dyn_cast<LoadInst>(&I))
+      return Load->getType();
+    return cast<StoreInst>(&I)->getValueOperand()->getType();
+  };
+
+  // puntatori candidati: destinazioni di store semplici, invarianti
+  SmallSetVector<Value *, 8> Candidates;
+  for (BasicBlock *BB : L->blocks())
+    for (Instruction &I : *BB)
+      if (auto *Store = dyn_cast<StoreInst>(&I))
+        if (Store->isSimple() && L->isLoopInvariant(Store->getPointerOperand()))
+          Candidates.insert(Store->getPointerOperand());
+
+  bool promotedAny = false;
+  MemorySSAUpdater MSSAU(&MSSA);
+
+  for (Value *Ptr : Candidates) {
+    // raccolta degli accessi a Ptr e controllo di tutti gli altri
+    SmallVector<Instruction *, 8> Uses;
+    auto findStore = [&]() -> StoreInst * {
+      for (BasicBlock *BB : L->blocks())
+        for (Instruction &I : *BB)
+          if (auto *Store = dyn_cast<StoreInst>(&I))
+            if (Store->isSimple() && Store->getPointerOperand() == Ptr)
+              return Store;
+      return nullptr;
+    };
+    StoreInst *FirstStore = findStore();
+    if (!FirstStore)
+      continue; // le store a Ptr sono gia state promosse con un alias
+    MemoryLocation Loc = MemoryLocation::get(FirstStore);
+    Type *Ty = FirstStore->getValueOperand()->getType();
+
+    bool conflict = false;
+    bool guaranteedStore = false;
+    Align Alignment = FirstStore->getAlign();
+    for (BasicBlock *BB : L->blocks()) {
+      for (Instruction &I : *BB) {
+        if (!I.mayReadOrWriteMemory())
+          continue;
+        bool simpleAccess =
+            (isa<LoadInst>(I) && cast<LoadInst>(I).isSimple()) ||
+            (isa<StoreInst>(I) && cast<StoreInst>(I).isSimple());
+        if (simpleAccess && accessedType(I) == Ty &&
+            AA.alias(MemoryLocation::get(&I), Loc) == AliasResult::MustAlias) {
+          Uses.push_back(&I);
+          Alignment = std::min(Alignment, getLoadStoreAlignment(&I));
+          if (isa<StoreInst>(I) && Safety.GuaranteedToExecute.count(BB))
+            guaranteedStore = true;
+          continue;
+        }
+        // qualsiasi altro accesso (call, load/store di altro tipo) che puo
+        // leggere o scrivere Ptr impedisce di tenerlo in un registro
+        if (isModOrRefSet(AA.getModRefInfo(&I, Loc))) {
+          conflict = true;
+          break;
+        }
+      }
+      if (conflict)
+        break;
+    }
+    if (conflict) {
+      ++NumPromotionAliasing;
+      LLVM_DEBUG(dbgs() << "Promozione di " << *Ptr
+                        << " rifiutata: accessi che possono fare alias\n");
+      continue;
+    }
+
+    bool safe = guaranteedStore && !Safety.MayThrow;
+    if (!safe) {
+      auto *Alloca = dyn_cast<AllocaInst>(getUnderlyingObject(Ptr));
+      safe = Alloca &&
+             !PointerMayBeCaptured(Alloca, /*ReturnCaptures=*/true,
+                                   /*StoreCaptures=*/true) &&
+             isDereferenceableAndAlignedPointer(Ptr, Ty, Alignment, DL,
+                                                preheader->getTerminator());
+    }
+    if (!safe) {
+      ++NumPromotionNotGuaranteed;
+      LLVM_DEBUG(dbgs() << "Promozione di " << *Ptr << " rifiutata: store "
+                        << "non eseguita a ogni iterazione\n");
+      continue;
+    }
+
+    // load nel preheader, poi riscrittura di load/store del loop
+    auto *PreLoad =
+        new LoadInst(Ty, Ptr, Ptr->getName() + ".promoted", /*isVolatile=*/false,
+                     Alignment, preheader->getTerminator());
+    MemoryAccess *PreMA =
+        MSSAU.createMemoryAccessInBB(PreLoad, nullptr, preheader,
+                                     MemorySSA::End);
+    MSSAU.insertUse(cast<MemoryUse>(PreMA), /*RenameUses=*/true);
+
+    SmallVector<PHINode *, 8> NewPHIs;
+    SSAUpdater SSA(&NewPHIs);
+    SmallVector<const Instruction *, 8> ConstUses(Uses.begin(), Uses.end());
+    LoopPromoter Promoter(ConstUses, SSA, Ptr, ExitBlocks, Alignment, MSSAU);
+    SSA.AddAvailableValue(preheader, PreLoad);
+    Promoter.run(Uses);
+
+    ++NumPromoted;
+    LLVM_DEBUG(dbgs() << "Promoted to register: " << *Ptr << " ("
+                      << Uses.size() << " accessi)\n");
+    promotedAny = true;
+  }
+
+  return promotedAny;
+}
+
+
 
 
 
@@ -141,7 +952,9 @@ bool LICMopt::runOnLoop(Loop *L, DominatorTree &DT) {
 // ################################################################################
 // qui stabilisco se una istruzione già riconosciuta Loop invriant può essere hoistata
 bool LICMopt::isSafeToMove(Instruction &I, Loop *L, DominatorTree &DT,
-                           SmallVector<BasicBlock *> ExitBlocks) {
+                           const TargetTransformInfo &TTI,
+                           const LICMLoopSafety &Safety,
+                           bool &Speculated) {
 
   // 1)
   // tutti gli usi di I devono essere dentro il loop
@@ -162,14 +975,9 @@ bool LICMopt::isSafeToMove(Instruction &I, Loop *L, DominatorTree &DT,
   // il blocco che contiene I domina tutti gli exit blocks del loop
   // quando ci sono usi fuori dal loop
   // Check if instruction will execute before any possible loop exit.
+  // (lookup nell'insieme precalcolato da computeLoopSafety)
   auto dominatesAllExitsControll = [&](Instruction &I) -> bool {
-    for (BasicBlock *Exit : ExitBlocks) {
-      if (!DT.dominates(I.getParent(), Exit)) {
-        return false;
-      }
-    }
-
-    return true;
+    return Safety.DominatesAllExits.count(I.getParent());
   };
 
   // 3)
@@ -192,11 +1000,13 @@ bool LICMopt::isSafeToMove(Instruction &I, Loop *L, DominatorTree &DT,
   // il bloco che contiene I domina il blocco di ogni uso
   // se vero spostare nel preheader aumenta la dominanza
   // The instruction must be executed before all its uses
+  // in SSA una definizione domina gia i suoi usi normali: resta da
+  // interrogare l'albero solo per le PHI, il cui uso vale alla fine del
+  // blocco di provenienza
   auto dominatesAllUsesControll = [&](Instruction &I) -> bool {
-    for (User *user : I.users()) {
-      if (Instruction *userInstr = dyn_cast<Instruction>(user)) {
-        BasicBlock *userBlock = userInstr->getParent();
-        if (userBlock && !DT.dominates(I.getParent(), userBlock)) {
+    for (Use &U : I.uses()) {
+      if (PHINode *phi = dyn_cast<PHINode>(U.getUser())) {
+        if (!DT.dominates(I.getParent(), phi->getIncomingBlock(U))) {
           return false;
         }
       }
@@ -204,12 +1014,43 @@ bool LICMopt::isSafeToMove(Instruction &I, Loop *L, DominatorTree &DT,
     return true;
   };
 
-  // alla fine se:
+  // 5)
+  // I e eseguita a ogni iterazione: il suo blocco domina uscite e latch
+  // e nessuna istruzione del loop puo lanciare o non ritornare prima
+  auto guaranteedToExecuteControll = [&](Instruction &I) -> bool {
+    return Safety.GuaranteedToExecute.count(I.getParent()) &&
+           !Safety.MayThrow;
+  };
+
+  // 6)
+  // hoisting speculativo: nel preheader I viene eseguita anche quando nel
+  // loop non lo sarebbe stata (dentro un if, dopo un'uscita). Serve che non
+  // possa fare trap o UB (niente divisioni per un valore forse nullo,
+  // load solo da puntatori dereferenziabili) e che costi poco
+  auto speculationControll = [&](Instruction &I) -> bool {
+    if (!isSafeToSpeculativelyExecute(&I,
+                                      L->getLoopPreheader()->getTerminator()))
+      return false;
+    InstructionCost Cost =
+        TTI.getInstructionCost(&I, TargetTransformInfo::TCK_SizeAndLatency);
+    return Cost.isValid() && Cost <= LICMoptSpeculationThreshold;
+  };
+
+  // alla fine se I e eseguita comunque (5) deve valere che:
   // 1. il valore non serve fuori
   // 2. (serve fuori) e il valore domina le uscite
   // 3. niente PHI interni che danno definizioni multi-cammino
   // 4. c'è dominanza su tutti gli usi
-  // ritorna true e rende l'istruzioni candidabile
-  return (deadOutsideLoopControll(I) || dominatesAllExitsControll(I)) && definedOnlyOnceControll(I) &&
-         dominatesAllUsesControll(I);
+  // altrimenti (non eseguita a ogni iterazione, o eseguita ma 1-4 non
+  // valgono) I si puo solo speculare (6): in SSA il valore invariante nel
+  // preheader domina ogni uso, PHI comprese, quindi 1-4 non servono.
+  // ritorna true e rende l'istruzioni candidabile; Speculated dice al
+  // chiamante se si e passati dal caso (6)
+  Speculated = false;
+  if (guaranteedToExecuteControll(I) &&
+      (deadOutsideLoopControll(I) || dominatesAllExitsControll(I)) &&
+      definedOnlyOnceControll(I) && dominatesAllUsesControll(I))
+    return true;
+  Speculated = true;
+  return speculationControll(I);
 }
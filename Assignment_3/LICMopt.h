@@ -13,17 +13,66 @@
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Module.h"
 
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetOperations.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/Loads.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Analysis/LoopAccessAnalysis.h"
+#include "llvm/Transforms/Utils/LoopVersioning.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 namespace llvm {
 
+// Fatti sul loop calcolati una volta in runOnLoop e condivisi da hoisting,
+// promozione e sinking: i controlli per istruzione diventano lookup O(1)
+struct LICMLoopSafety {
+  SmallVector<BasicBlock *> ExitBlocks;
+  // blocchi del loop che dominano tutti gli exit block
+  SmallPtrSet<BasicBlock *, 16> DominatesAllExits;
+  // blocchi che dominano anche tutti i latch: ogni iterazione ci passa
+  SmallPtrSet<BasicBlock *, 16> GuaranteedToExecute;
+  // qualche istruzione del loop puo lanciare o non ritornare
+  bool MayThrow = false;
+};
+
 class LICMopt : public PassInfoMixin<LICMopt> {
 public:
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM);
-  bool isSafeToMove(Instruction &I, Loop *L, DominatorTree &DT, SmallVector<BasicBlock*> ExitBlocks);
-  bool runOnLoop(Loop *L, DominatorTree &DT);
+  PreservedAnalyses run(Loop &L, LoopAnalysisManager &LAM,
+                        LoopStandardAnalysisResults &AR, LPMUpdater &U);
+  bool versionLoops(Function &F, LoopInfo &LI, DominatorTree &DT,
+                    FunctionAnalysisManager &FAM);
+  bool unswitchLoops(Function &F, LoopInfo &LI, DominatorTree &DT);
+  static void unswitchLoop(Loop *L, BranchInst *BI, LoopInfo &LI,
+                           DominatorTree &DT);
+  static void computeLoopSafety(Loop *L, DominatorTree &DT,
+                                LICMLoopSafety &Safety);
+  bool isSafeToMove(Instruction &I, Loop *L, DominatorTree &DT,
+                    const TargetTransformInfo &TTI,
+                    const LICMLoopSafety &Safety, bool &Speculated);
+  bool runOnLoop(Loop *L, LoopInfo &LI, DominatorTree &DT, MemorySSA &MSSA,
+                 AAResults &AA, const TargetTransformInfo &TTI,
+                 ScalarEvolution *SE);
+  bool promoteMemory(Loop *L, DominatorTree &DT, MemorySSA &MSSA,
+                     AAResults &AA, const LICMLoopSafety &Safety);
+  bool sinkToExits(Loop *L, DominatorTree &DT, const LICMLoopSafety &Safety);
 
 };
 }
@@ -21,10 +21,17 @@ echo "[1/3] Compilazione..."
 "$CLANG" -O0 -Xclang -disable-O0-optnone -emit-llvm -c "$SRC" -o "$BC"
 
 echo "[2/3] Preparazione (mem2reg)..."
-"$OPT" -S -verify-each -passes='mem2reg,loop-simplify' "$BC" -o "$BASE_LL"
+# loop-rotate porta i loop in forma do-while: il corpo domina l'uscita e le
+# store dell'accumulatore diventano promuovibili a registro
+"$OPT" -S -verify-each -passes='mem2reg,loop-simplify,loop-rotate' "$BC" -o "$BASE_LL"
 
 echo "[3/3] Esecuzione $PASS_NAME..."
 "$OPT" -S -verify-each -passes="$PASS_NAME" "$BASE_LL" -o "$OUT_LL"
+# con -licm-opt-versioning i loop bloccati da puntatori che possono fare
+# alias vengono duplicati dietro un controllo a runtime; con
+# -licm-opt-unswitch i branch su condizioni invarianti escono dal loop
+# in alternativa come loop pass, nella stessa pipeline di loop-rotate:
+# "$OPT" -S -verify-each -passes="loop-mssa(loop-rotate,$PASS_NAME)" "$BASE_LL" -o "$OUT_LL"
 
 echo
 echo
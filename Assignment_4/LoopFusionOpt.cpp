@@ -5,6 +5,13 @@
 
 using namespace llvm;
 
+// Limite alle query di DependenceAnalysis per coppia di gruppi di accessi
+// (stesso oggetto sottostante): oltre si rinuncia alla fusione invece di
+// confrontare tutte le coppie
+static cl::opt<unsigned> LoopFusionOptMaxPairs(
+    "loop-fusion-opt-max-pairs", cl::init(1024), cl::Hidden,
+    cl::desc("Coppie di accessi massime confrontate per gruppo"));
+
 // *****************************************************************************
 // Driver del passo
 llvm::PreservedAnalyses llvm::LoopFusionOpt::run(Function &F,
@@ -19,15 +26,24 @@ llvm::PreservedAnalyses llvm::LoopFusionOpt::run(Function &F,
   outs() << "\nAvvio LoopFusionOpt su funzione: " << F.getName() << "\n";
   auto &LI = FAM.getResult<LoopAnalysis>(F);
   bool changed = false;
-  const std::vector<Loop *> &topLevelLoops = LI.getTopLevelLoops();
-  // crea array di loop toplevel da LI
+  const std::vector<Loop *> topLevelLoops = LI.getTopLevelLoops();
+  // crea array di loop toplevel da LI (una copia: la fusione toglie da LI
+  // il secondo loop di ogni coppia)
 
   changed = runOnLoops(F, FAM, topLevelLoops);
   // tenta di fare delle fusioni interne passandogli analizzatore, toplevel loops e F
 
-  if (changed)
-    return llvm::PreservedAnalyses::none();
-  return llvm::PreservedAnalyses::all();
+  if (!changed)
+    return llvm::PreservedAnalyses::all();
+
+  // fuseLoops tiene aggiornate queste analisi a ogni fusione (il CFG invece
+  // cambia, quindi tutto il resto va ricalcolato)
+  PreservedAnalyses PA;
+  PA.preserve<DominatorTreeAnalysis>();
+  PA.preserve<PostDominatorTreeAnalysis>();
+  PA.preserve<LoopAnalysis>();
+  PA.preserve<ScalarEvolutionAnalysis>();
+  return PA;
 }
 
 // *****************************************************************************
@@ -72,20 +88,6 @@ bool LoopFusionOpt::runOnLoops(Function &F, FunctionAnalysisManager &FAM,
 }
 
 
-// Helper per cancellare blocchi divenuti inutili dopo la fusione.
-// Non devono avere piu usi
-static void deleteBlock(BasicBlock *BB) {
-  if (!BB)
-    return;
-  // Il blocco deve essere completamente scollegato dal CFG.
-  assert(BB->use_empty() && "Deleting a block that is still referenced");
-  // Rimuove tutte le istruzioni dal blocco (dal fondo per sicurezza),
-  while (!BB->empty())
-    BB->back().eraseFromParent();
-  BB->eraseFromParent();
-}
-
-
 // *****************************************************************************
 // Esegue il taglia e cuci
 Loop *LoopFusionOpt::fuseLoops(Function &F, FunctionAnalysisManager &FAM,
@@ -96,6 +98,8 @@ Loop *LoopFusionOpt::fuseLoops(Function &F, FunctionAnalysisManager &FAM,
 
   ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
   auto &LI = FAM.getResult<LoopAnalysis>(F);
+  DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  PostDominatorTree &PDT = FAM.getResult<PostDominatorTreeAnalysis>(F);
 
   // === Componenti fondamentali dei due loop ===
   auto *firstPreheader = First->getLoopPreheader();
@@ -126,6 +130,37 @@ Loop *LoopFusionOpt::fuseLoops(Function &F, FunctionAnalysisManager &FAM,
   auto *secondHeader = secondPreheader->getSingleSuccessor();
   auto *secondGuard = Second->getLoopGuardBranch();
 
+  // Robustezza: nel caso guarded serve un successore unico dell'uscita
+  // comune; lo si controlla prima di toccare l'IR
+  if (firstGuard && secondGuard && !secondExit->getSingleSuccessor())
+    return nullptr;
+
+  // Blocchi ricollegati dalla fusione e loro archi originali: alla fine a
+  // DomTreeUpdater passano solo gli archi cambiati, cosi DT e PDT restano
+  // validi per le fusioni successive senza ricalcolarli
+  SmallSetVector<BasicBlock *, 8> touchedBlocks;
+  touchedBlocks.insert(firstExit);
+  touchedBlocks.insert(firstLatch);
+  touchedBlocks.insert(firstBody);
+  touchedBlocks.insert(secondBody);
+  touchedBlocks.insert(secondLatch);
+  touchedBlocks.insert(secondPreheader);
+  if (firstGuard && secondGuard) {
+    touchedBlocks.insert(firstGuard->getParent());
+    touchedBlocks.insert(secondGuard->getParent());
+  }
+  SmallVector<std::pair<BasicBlock *, BasicBlock *>, 16> oldEdges;
+  for (BasicBlock *BB : touchedBlocks)
+    for (BasicBlock *Succ : successors(BB))
+      oldEdges.push_back({BB, Succ});
+
+  // blocchi da cancellare, rimossi solo a CFG ricucito
+  SmallVector<BasicBlock *, 4> deadBlocks;
+
+  // SCEV dei due loop (trip count, AddRec) non vale piu dopo la fusione
+  SE.forgetLoop(First);
+  SE.forgetLoop(Second);
+
   // === 1) Unificazione della i: Loop2 usa la i di Loop1 al posto della sua j ===
   auto *firstIV = First->getInductionVariable(SE);
   auto *secondIV = Second->getInductionVariable(SE);
@@ -226,10 +261,6 @@ Loop *LoopFusionOpt::fuseLoops(Function &F, FunctionAnalysisManager &FAM,
   if (firstGuard && secondGuard) {
     BasicBlock *guardDest = secondExit->getSingleSuccessor();
 
-    // Robustezza: se non esiste un successor unico, abortiamo
-    if (!guardDest)
-      return nullptr;
-
     // Il ramo "non loop" della guard di First deve saltare all'uscita comune.
     firstGuard->setSuccessor(1, guardDest);
     guardDest->replacePhiUsesWith(secondGuard->getParent(),
@@ -254,8 +285,8 @@ Loop *LoopFusionOpt::fuseLoops(Function &F, FunctionAnalysisManager &FAM,
 
     guardDest->replacePhiUsesWith(firstExit, secondExit);
 
-    deleteBlock(secondGuard->getParent());
-    deleteBlock(firstExit);
+    deadBlocks.push_back(secondGuard->getParent());
+    deadBlocks.push_back(firstExit);
   }
   // se salta il primo loop anche il secondo, poi prendo i pezzi nel Guard2 e li
   // metto
@@ -267,22 +298,59 @@ Loop *LoopFusionOpt::fuseLoops(Function &F, FunctionAnalysisManager &FAM,
   secondBody->getTerminator()->replaceSuccessorWith(secondLatch, firstLatch);
   secondLatch->getTerminator()->replaceSuccessorWith(secondExit, secondLatch);
 
-  deleteBlock(secondLatch);
-  deleteBlock(secondPreheader);
+  deadBlocks.push_back(secondLatch);
+  if (!is_contained(deadBlocks, secondPreheader))
+    // (senza guard il preheader del secondo e l'uscita del primo)
+    deadBlocks.push_back(secondPreheader);
 
 
   // === 5) Aggiorna LoopInfo: i blocchi del secondo loop diventano blocchi del primo ===
-  SmallVector<BasicBlock *, 16> secondBlocks;
-  for (BasicBlock *BB : Second->getBlocks()) {
-    if (BB == secondLatch || BB == secondPreheader)
-      continue;
-    secondBlocks.push_back(BB);
-  }
+  for (BasicBlock *BB : deadBlocks)
+    LI.removeBlock(BB);
 
+  SmallVector<BasicBlock *, 16> secondBlocks(Second->getBlocks().begin(),
+                                             Second->getBlocks().end());
   for (BasicBlock *BB : secondBlocks) {
-    First->addBasicBlockToLoop(BB, LI);
+    Second->removeBlockFromLoop(BB);
+    First->addBlockEntry(BB);
+    // i blocchi dei sottoloop restano ai sottoloop
+    if (LI.getLoopFor(BB) == Second)
+      LI.changeLoopFor(BB, First);
     BB->moveBefore(firstLatch);
   }
+  // eventuali sottoloop passano al primo, poi il secondo (vuoto) sparisce
+  while (!Second->isInnermost()) {
+    Loop *Child = Second->removeChildLoop(std::prev(Second->end()));
+    First->addChildLoop(Child);
+  }
+  LI.erase(Second);
+
+
+  // === 6) Aggiorna DT e PDT con i soli archi cambiati ===
+  // i blocchi morti perdono il terminatore: senza archi in uscita nessun
+  // blocco vivo li ha piu come predecessori
+  for (BasicBlock *BB : deadBlocks) {
+    BB->getTerminator()->eraseFromParent();
+    new UnreachableInst(BB->getContext(), BB);
+  }
+
+  SmallVector<DominatorTree::UpdateType, 16> Updates;
+  for (auto &Edge : oldEdges)
+    if (!is_contained(successors(Edge.first), Edge.second))
+      Updates.push_back({DominatorTree::Delete, Edge.first, Edge.second});
+  for (BasicBlock *BB : touchedBlocks)
+    for (BasicBlock *Succ : successors(BB))
+      if (!is_contained(oldEdges, std::make_pair(BB, Succ)))
+        Updates.push_back({DominatorTree::Insert, BB, Succ});
+
+  DomTreeUpdater DTU(DT, PDT, DomTreeUpdater::UpdateStrategy::Lazy);
+  DTU.applyUpdatesPermissive(Updates);
+  for (BasicBlock *BB : deadBlocks)
+    DTU.deleteBB(BB);
+  DTU.flush();
+
+  // le istruzioni del secondo loop ora variano con il primo
+  SE.forgetLoopDispositions();
 
   return First;
 }
@@ -384,13 +452,76 @@ bool LoopFusionOpt::isOptimizable(Function &F, FunctionAnalysisManager &FAM,
     }
 
     // Controllo decisivo
-    if (firstExitBB == secondEntryBB) {
-      OS << "   [OK] I loop sono adiacenti.\n";
-      return true;
+    if (firstExitBB != secondEntryBB) {
+      OS << "   [FALLITO] I loop NON sono adiacenti.\n";
+      return false;
     }
 
-    OS << "   [FALLITO] I loop NON sono adiacenti.\n";
-    return false;
+    // fuseLoops cancella uscita del primo, preheader, guard e latch del
+    // secondo: DTU.deleteBB rimpiazzerebbe con poison gli usi di quello che
+    // resta dentro, quindi ci deve essere solo quello che la fusione sposta
+    ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+    PHINode *secondIV = Second->getInductionVariable(SE);
+    BasicBlock *firstExit = First->getExitBlock();
+    BasicBlock *secondPreheader = Second->getLoopPreheader();
+    BasicBlock *secondLatch = Second->getLoopLatch();
+
+    // uscita del primo: solo LCSSA (spostate nell'uscita comune) e branch
+    for (Instruction &I : *firstExit)
+      if (!isa<PHINode>(I) && !I.isTerminator()) {
+        OS << "   [FALLITO] Codice nell'uscita del primo loop.\n";
+        return false;
+      }
+    // preheader del secondo: solo il branch
+    if (secondPreheader != firstExit && secondPreheader->size() != 1) {
+      OS << "   [FALLITO] Codice nel preheader del secondo loop.\n";
+      return false;
+    }
+
+    // guard del secondo: niente PHI, condizione usata solo dal branch, il
+    // resto scende dopo il loop fuso e non deve servire al secondo loop
+    if (Second->isGuarded()) {
+      BranchInst *GB = Second->getLoopGuardBranch();
+      for (Instruction &I : *secondEntryBB) {
+        if (I.isTerminator())
+          continue;
+        bool usatoDentro = isa<PHINode>(I);
+        for (User *U : I.users()) {
+          BasicBlock *UB = cast<Instruction>(U)->getParent();
+          if (U != GB && (&I == GB->getCondition() || UB == secondPreheader ||
+                          Second->contains(UB)))
+            usatoDentro = true;
+        }
+        if (usatoDentro) {
+          OS << "   [FALLITO] Guard del secondo loop usata dal secondo loop.\n";
+          return false;
+        }
+      }
+    }
+
+    // latch del secondo: solo calcoli senza effetti che servono al latch
+    // stesso o alla IV (rimpiazzata da quella del primo)
+    if (!secondIV) {
+      OS << "   [FALLITO] IV del secondo loop non trovata.\n";
+      return false;
+    }
+    for (Instruction &I : *secondLatch) {
+      if (I.isTerminator())
+        continue;
+      bool locale = !isa<PHINode>(I) && !I.mayHaveSideEffects() &&
+                    llvm::all_of(I.users(), [&](User *U) {
+                      auto *UI = cast<Instruction>(U);
+                      return UI->getParent() == secondLatch || UI == secondIV;
+                    });
+      if (!locale) {
+        OS << "   [FALLITO] Il latch del secondo loop calcola valori usati "
+              "fuori dal latch.\n";
+        return false;
+      }
+    }
+
+    OS << "   [OK] I loop sono adiacenti.\n";
+    return true;
   };
 
   // ==== 2) TRIP COUNT ====
@@ -502,95 +633,183 @@ bool LoopFusionOpt::isOptimizable(Function &F, FunctionAnalysisManager &FAM,
 
 // ==== 4) DEPENDENCE CHECK ====
 // Obiettivo: evitare fusioni non sicure per dipendenze tra i due loop.
+// Dopo la fusione l'iterazione k del secondo loop gira subito dopo la k del
+// primo: una dipendenza dall'iterazione i del primo all'iterazione j del
+// secondo resta rispettata se j >= i (in avanti o nella stessa iterazione),
+// viene invertita se j < i (all'indietro). Si rifiutano solo queste e le
+// dipendenze che non si sanno misurare.
 auto notDependenciesControll = [&]() -> bool {
   OS << "\n[Check 4/4] Dipendenze\n";
 
   auto &DI = FAM.getResult<DependenceAnalysis>(F);
   ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+
+  auto &AA = FAM.getResult<AAManager>(F);
+
+  // Accessi a memoria di un loop raggruppati per oggetto sottostante
+  // (alloca, globale, argomento...). Load e store vanno a DI.depends; le
+  // altre istruzioni che toccano memoria (call, atomiche) DI non le sa
+  // analizzare e restano a parte
+  struct Accessi {
+    SmallVector<Instruction *, 8> Loads;
+    SmallVector<Instruction *, 8> Stores;
+  };
+  struct AccessiLoop {
+    MapVector<const Value *, Accessi> Buckets;
+    SmallVector<Instruction *, 4> Altri;
+    bool Legge = false;
+    bool Scrive = false;
+  };
+  auto raccogliAccessi = [&](Loop *L) {
+    AccessiLoop R;
+    for (auto *BB : L->getBlocks())
+      for (auto &I : *BB) {
+        if (!I.mayReadOrWriteMemory())
+          continue;
+        R.Legge |= I.mayReadFromMemory();
+        R.Scrive |= I.mayWriteToMemory();
+        auto *S = dyn_cast<StoreInst>(&I);
+        auto *Ld = dyn_cast<LoadInst>(&I);
+        if (S && S->isSimple())
+          R.Buckets[getUnderlyingObject(S->getPointerOperand())]
+              .Stores.push_back(&I);
+        else if (Ld && Ld->isSimple())
+          R.Buckets[getUnderlyingObject(Ld->getPointerOperand())]
+              .Loads.push_back(&I);
+        else
+          R.Altri.push_back(&I);
+      }
+    return R;
+  };
+
+  // Distanza in iterazioni j - i fra l'accesso di I1 (primo loop) e quello
+  // di I2 (secondo loop) alla stessa locazione, come se i loop fossero gia
+  // fusi: gli indirizzi devono essere AddRec affini dei due loop con lo
+  // stesso passo costante, {S1,+,St} e {S2,+,St}, e S1 + St*i = S2 + St*j
+  // da j - i = (S1 - S2) / St. Gli accessi devono avere la stessa ampiezza
+  // e non superare |St|, altrimenti un'iterazione tocca anche l'elemento
+  // della successiva. nullopt se la distanza non e una costante
   const DataLayout &DL = F.getParent()->getDataLayout();
+  auto distanzaFusa = [&](Instruction *I1,
+                          Instruction *I2) -> std::optional<int64_t> {
+    auto *AR1 = dyn_cast<SCEVAddRecExpr>(
+        SE.getSCEV(getLoadStorePointerOperand(I1)));
+    auto *AR2 = dyn_cast<SCEVAddRecExpr>(
+        SE.getSCEV(getLoadStorePointerOperand(I2)));
+    if (!AR1 || !AR2 || AR1->getLoop() != First || AR2->getLoop() != Second ||
+        !AR1->isAffine() || !AR2->isAffine())
+      return std::nullopt;
+
+    auto *Step1 = dyn_cast<SCEVConstant>(AR1->getStepRecurrence(SE));
+    auto *Step2 = dyn_cast<SCEVConstant>(AR2->getStepRecurrence(SE));
+    if (!Step1 || Step1 != Step2 || Step1->getAPInt().isZero())
+      return std::nullopt;
+
+    TypeSize Size1 = DL.getTypeStoreSize(getLoadStoreType(I1));
+    TypeSize Size2 = DL.getTypeStoreSize(getLoadStoreType(I2));
+    if (Size1 != Size2 || Size1.isScalable() ||
+        Size1.getFixedValue() > Step1->getAPInt().abs().getZExtValue())
+      return std::nullopt;
+
+    auto *Diff = dyn_cast<SCEVConstant>(
+        SE.getMinusSCEV(AR1->getStart(), AR2->getStart()));
+    if (!Diff)
+      return std::nullopt;
+
+    APInt Quoziente, Resto;
+    APInt::sdivrem(Diff->getAPInt(), Step1->getAPInt(), Quoziente, Resto);
+    if (!Resto.isZero())
+      // accessi sfalsati che si sovrappongono in parte
+      return std::nullopt;
+    return Quoziente.getSExtValue();
+  };
 
-  // Ritorna il pointer operand solo per load/store (altrimenti nullptr).
-  auto getInstructionPointer = [&](Instruction *Inst) -> Value * {
-    if (auto *S = dyn_cast<StoreInst>(Inst))
-      return S->getPointerOperand();
-    if (auto *L = dyn_cast<LoadInst>(Inst))
-      return L->getPointerOperand();
-    return nullptr;
+  // true se la coppia (I1 nel primo loop, I2 nel secondo) impedisce la
+  // fusione. run fonde solo loop top-level fratelli: non hanno loop comuni,
+  // quindi DI non da livelli (getLevels() == 0) e niente direzioni o
+  // distanze da leggere. DI serve solo a scartare le coppie indipendenti,
+  // per le altre (confuse comprese) decide la distanza a loop fusi
+  auto dipendenzaVietata = [&](Instruction *I1, Instruction *I2) -> bool {
+    if (!DI.depends(I1, I2, /*LoopIndependent=*/true))
+      return false;
+
+    auto stampa = [&](const char *Motivo) {
+      OS << "   [FALLITO] " << Motivo << "\n";
+      OS << "     I1 (" << I1->getParent()->getName() << "): " << *I1 << "\n";
+      OS << "     I2 (" << I2->getParent()->getName() << "): " << *I2 << "\n";
+    };
+
+    std::optional<int64_t> Dist = distanzaFusa(I1, I2);
+    if (!Dist) {
+      stampa("dipendenza con distanza non calcolabile");
+      return true;
+    }
+    if (*Dist < 0) {
+      stampa("dipendenza con distanza negativa");
+      OS << "     distanza(iterazioni) = " << *Dist << "\n";
+      return true;
+    }
+    return false;
   };
 
+  auto coppieVietate = [&](ArrayRef<Instruction *> A,
+                           ArrayRef<Instruction *> B) -> bool {
+    for (Instruction *I1 : A)
+      for (Instruction *I2 : B)
+        if (dipendenzaVietata(I1, I2))
+          return true;
+    return false;
+  };
 
-  for (auto *BB1 : First->getBlocks()) {
-    for (auto &I1 : *BB1) {
-      for (auto *BB2 : Second->getBlocks()) {
-        for (auto &I2 : *BB2) {
-
-          // 1) Esiste una dipendenza tra I1 e I2?
-          auto Dep = DI.depends(&I1, &I2, /*LoopIndependent=*/true);
-          if (!Dep)
-            continue;
-
-          // 2) Provo ad estrarre i pointer operand (solo load/store).
-          Value *P1 = getInstructionPointer(&I1);
-          Value *P2 = getInstructionPointer(&I2);
-          if (!P1 || !P2) {
-            continue;
-          }
-
-          // 3) Rappresento gli indirizzi come espressioni SCEV.
-          const SCEV *E1 = SE.getSCEV(P1);
-          const SCEV *E2 = SE.getSCEV(P2);
-
-          // 4) Voglio AddRec (pattern affine nel loop) per stimare una distanza.
-          auto *AR1 = dyn_cast<SCEVAddRecExpr>(E1);
-          auto *AR2 = dyn_cast<SCEVAddRecExpr>(E2);
-          if (!AR1 || !AR2) {
-            continue;
-          }
-
-          // 5) Se gli step sono diversi, niente confronto.
-          const SCEV *Step1 = AR1->getStepRecurrence(SE);
-          const SCEV *Step2 = AR2->getStepRecurrence(SE);
-          if (Step1 != Step2) {
-            continue;
-          }
-
-          // 6) Distanza = start1 - start2. Deve essere costante per usarla.
-          const SCEV *Dist = SE.getMinusSCEV(AR1->getStart(), AR2->getStart());
-          auto *CD = dyn_cast<SCEVConstant>(Dist);
-          if (!CD) {
-            continue;
-          }
-
-          // 7) Converto la distanza da byte a numero di elementi.
-          const APInt &ByteOffset = CD->getAPInt();
-
-          auto *GEP1 = dyn_cast<GetElementPtrInst>(P1);
-          auto *GEP2 = dyn_cast<GetElementPtrInst>(P2);
-          if (!GEP1 && !GEP2) {
-            continue;
-          }
-
-          Type *ElemTy = GEP1 ? GEP1->getResultElementType()
-                              : GEP2->getResultElementType();
-
-          uint64_t ElemSize = DL.getTypeAllocSize(ElemTy);
-          if (ElemSize == 0) {
-            continue;
-          }
-
-          int64_t ElementOffset =
-              ByteOffset.getSExtValue() / (int64_t)ElemSize;
-
-          // se la distanza è negativa, la fusione non e sicura
-          if (ElementOffset < 0) {
-            OS << "   [FALLITO] dipendenza con distanza negativa\n";
-            OS << "     I1 (" << BB1->getName() << "): " << I1 << "\n";
-            OS << "     I2 (" << BB2->getName() << "): " << I2 << "\n";
-            OS << "     distanza(elementi) = " << ElementOffset << "\n";
-            return false;
-          }
-        }
+  AccessiLoop AccFirst = raccogliAccessi(First);
+  AccessiLoop AccSecond = raccogliAccessi(Second);
+
+  // call o accessi non semplici: dipendenza sconosciuta se dall'altra parte
+  // c'e un accesso che con loro forma una coppia con scrittura
+  auto altriAccessiVietati = [&](const AccessiLoop &X,
+                                 const AccessiLoop &Y) -> bool {
+    for (Instruction *I : X.Altri)
+      if (I->mayWriteToMemory() ? (Y.Legge || Y.Scrive) : Y.Scrive) {
+        OS << "   [FALLITO] accesso a memoria non analizzabile\n";
+        OS << "     " << *I << "\n";
+        return true;
       }
+    return false;
+  };
+  if (altriAccessiVietati(AccFirst, AccSecond) ||
+      altriAccessiVietati(AccSecond, AccFirst))
+    return false;
+
+  // Invece di interrogare DI su ogni coppia di istruzioni dei due loop:
+  // - si confrontano solo gruppi il cui oggetto sottostante puo fare alias
+  //   (due alloca o globali diversi non si toccano mai)
+  // - dentro i gruppi solo coppie con almeno una store (load/load non
+  //   creano dipendenze)
+  for (auto &B1 : AccFirst.Buckets) {
+    for (auto &B2 : AccSecond.Buckets) {
+      if (B1.first != B2.first &&
+          AA.isNoAlias(MemoryLocation(B1.first,
+                                      LocationSize::beforeOrAfterPointer()),
+                       MemoryLocation(B2.first,
+                                      LocationSize::beforeOrAfterPointer())))
+        continue;
+
+      const Accessi &A1 = B1.second;
+      const Accessi &A2 = B2.second;
+      // dentro un gruppo le coppie restano tutte contro tutte: gruppi
+      // troppo grandi si rifiutano
+      uint64_t Coppie =
+          uint64_t(A1.Stores.size()) * (A2.Loads.size() + A2.Stores.size()) +
+          uint64_t(A1.Loads.size()) * A2.Stores.size();
+      if (Coppie > LoopFusionOptMaxPairs) {
+        OS << "   [FALLITO] troppe coppie di accessi da confrontare ("
+           << Coppie << ")\n";
+        return false;
+      }
+      if (coppieVietate(A1.Stores, A2.Loads) ||
+          coppieVietate(A1.Stores, A2.Stores) ||
+          coppieVietate(A1.Loads, A2.Stores))
+        return false;
     }
   }
 
@@ -18,7 +18,11 @@
 // LLVM Containers and Utilities
 #include "llvm/ADT/APInt.h" // Per APInt
 #include "llvm/ADT/SmallVector.h" // Per SmallVector
+#include "llvm/ADT/MapVector.h" // Per MapVector
+#include "llvm/ADT/SetVector.h" // Per SmallSetVector
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/CommandLine.h" // Per cl::opt
+#include <optional>
 
 // Core Analysis
 #include "llvm/Analysis/LoopInfo.h"
@@ -27,6 +31,9 @@
 #include "llvm/Analysis/DependenceAnalysis.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/DomTreeUpdater.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ValueTracking.h" // Per getUnderlyingObject
 
 // Transformation Utilities
 #include "llvm/Transforms/Utils/Local.h"